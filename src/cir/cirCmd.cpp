@@ -54,7 +54,8 @@ enum CirCmdState
 static CirCmdState curCmd = CIRINIT;
 
 //----------------------------------------------------------------------
-//    CIRRead <(string fileName)> [-Replace]
+//    CIRRead <(string fileName)> [-Replace] [-Simplify]
+//            [-Threads (int numThreads)]
 //----------------------------------------------------------------------
 CmdExecStatus
 CirReadCmd::exec(const string& option)
@@ -66,13 +67,27 @@ CirReadCmd::exec(const string& option)
    if (options.empty())
       return CmdExec::errorOption(CMD_OPT_MISSING, "");
 
-   bool doReplace = false;
+   bool doReplace = false, doSimplify = false, doThreads = false;
+   int numThreads = 1;
    string fileName;
    for (size_t i = 0, n = options.size(); i < n; ++i) {
       if (myStrNCmp("-Replace", options[i], 2) == 0) {
          if (doReplace) return CmdExec::errorOption(CMD_OPT_EXTRA,options[i]);
          doReplace = true;
       }
+      else if (myStrNCmp("-Simplify", options[i], 2) == 0) {
+         if (doSimplify) return CmdExec::errorOption(CMD_OPT_EXTRA,options[i]);
+         doSimplify = true;
+      }
+      else if (myStrNCmp("-Threads", options[i], 2) == 0) {
+         if (doThreads)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!myStr2Int(options[i], numThreads) || numThreads < 1 || numThreads > 256)
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+         doThreads = true;
+      }
       else {
          if (fileName.size())
             return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
@@ -93,7 +108,7 @@ CirReadCmd::exec(const string& option)
    }
    cirMgr = new CirMgr;
 
-   if (!cirMgr->readCircuit(fileName)) {
+   if (!cirMgr->readCircuit(fileName, numThreads, doSimplify)) {
       curCmd = CIRINIT;
       delete cirMgr; cirMgr = 0;
       return CMD_EXEC_ERROR;
@@ -107,7 +122,8 @@ CirReadCmd::exec(const string& option)
 void
 CirReadCmd::usage(ostream& os) const
 {
-   os << "Usage: CIRRead <(string fileName)> [-Replace]" << endl;
+   os << "Usage: CIRRead <(string fileName)> [-Replace] [-Simplify]\n"
+      << "               [-Threads (int numThreads)]" << endl;
 }
 
 void
@@ -375,7 +391,11 @@ CirStrashCmd::help() const
 
 //----------------------------------------------------------------------
 //    CIRSIMulate <-Random | -File <string patternFile>>
-//                [-Output (string logFile)]
+//                [-Output (string logFile) [-Binary]] [-Words (int numWords)]
+//                [-Threads (int numThreads)] [-Seed (int seed)]
+//                [-Patterns (int maxPatterns)] [-TIme (int maxSeconds)] [-Guided]
+//    With -Words n > 1, CIRGate shows the first 64 patterns of the final
+//    block of 64*n patterns.
 //----------------------------------------------------------------------
 CmdExecStatus
 CirSimCmd::exec(const string& option)
@@ -390,7 +410,11 @@ CirSimCmd::exec(const string& option)
 
    ifstream patternFile;
    ofstream logFile;
-   bool doRandom = false, doFile = false, doLog = false;
+   string logName;
+   bool doRandom = false, doFile = false, doLog = false, doWords = false;
+   bool doThreads = false, doSeed = false, doBinary = false;
+   bool doPatterns = false, doTime = false, doGuided = false;
+   int numWords = 0, numThreads = 0, seed = 0, numPatterns = 0, seconds = 0;
    for (size_t i = 0, n = options.size(); i < n; ++i) {
       if (myStrNCmp("-Random", options[i], 2) == 0) {
          if (doRandom || doFile)
@@ -412,25 +436,97 @@ CirSimCmd::exec(const string& option)
             return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
          if (++i == n)
             return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
-         logFile.open(options[i].c_str(), ios::out);
-         if (!logFile)
-            return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, options[i]);
+         logName = options[i];
          doLog = true;
       }
+      else if (myStrNCmp("-Binary", options[i], 2) == 0) {
+         if (doBinary)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         doBinary = true;
+      }
+      else if (myStrNCmp("-Words", options[i], 2) == 0) {
+         if (doWords)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!myStr2Int(options[i], numWords) || numWords < 1 || numWords > 64)
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+         doWords = true;
+      }
+      else if (myStrNCmp("-Threads", options[i], 2) == 0) {
+         if (doThreads)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!myStr2Int(options[i], numThreads) || numThreads < 1 || numThreads > 256)
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+         doThreads = true;
+      }
+      else if (myStrNCmp("-Guided", options[i], 2) == 0) {
+         if (doGuided)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         doGuided = true;
+      }
+      else if (myStrNCmp("-Patterns", options[i], 2) == 0) {
+         if (doPatterns)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!myStr2Int(options[i], numPatterns) || numPatterns < 1)
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+         doPatterns = true;
+      }
+      else if (myStrNCmp("-TIme", options[i], 3) == 0) {
+         if (doTime)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!myStr2Int(options[i], seconds) || seconds < 1)
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+         doTime = true;
+      }
+      else if (myStrNCmp("-Seed", options[i], 2) == 0) {
+         if (doSeed)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!myStr2Int(options[i], seed) || seed < 0)
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+         doSeed = true;
+      }
       else
          return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
    }
 
    if (!doRandom && !doFile)
       return CmdExec::errorOption(CMD_OPT_MISSING, "");
+   if (doBinary && !doLog)
+      return CmdExec::errorOption(CMD_OPT_ILLEGAL, "-Binary");
+   if (doFile && doPatterns)
+      return CmdExec::errorOption(CMD_OPT_ILLEGAL, "-Patterns");
+   if (doFile && doTime)
+      return CmdExec::errorOption(CMD_OPT_ILLEGAL, "-TIme");
+   if (doFile && doGuided)
+      return CmdExec::errorOption(CMD_OPT_ILLEGAL, "-Guided");
+   if (doLog) {
+      logFile.open(logName.c_str(), doBinary ? ios::out | ios::binary : ios::out);
+      if (!logFile)
+         return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, logName);
+   }
 
    assert (curCmd != CIRINIT);
    if (doLog)
-      cirMgr->setSimLog(&logFile);
+      cirMgr->setSimLog(&logFile, doBinary);
    else cirMgr->setSimLog(0);
+   if (doWords)
+      cirMgr->setSimWords(numWords);
+   if (doThreads)
+      cirMgr->setSimThreads(numThreads);
+   if (doSeed)
+      rnGen.reset(seed);
 
    if (doRandom)
-      cirMgr->randomSim();
+      cirMgr->randomSim(numPatterns, seconds, doGuided);
    else
       cirMgr->fileSim(patternFile);
    cirMgr->setSimLog(0);
@@ -443,7 +539,11 @@ void
 CirSimCmd::usage(ostream& os) const
 {
    os << "Usage: CIRSIMulate <-Random | -File <string patternFile>>\n"
-      << "                   [-Output (string logFile)]" << endl;
+      << "                   [-Output (string logFile) [-Binary]] [-Words (int numWords)]\n"
+      << "                   [-Threads (int numThreads)] [-Seed (int seed)]\n"
+      << "                   [-Patterns (int maxPatterns)] [-TIme (int maxSeconds)] [-Guided]\n"
+      << "       (with -Words n > 1, CIRGate shows the first 64 patterns of the final\n"
+      << "        block of 64*n patterns)" << endl;
 }
 
 void
@@ -454,7 +554,7 @@ CirSimCmd::help() const
 }
 
 //----------------------------------------------------------------------
-//    CIRFraig
+//    CIRFraig [-Threads (int numThreads)]
 //----------------------------------------------------------------------
 CmdExecStatus
 CirFraigCmd::exec(const string& option)
@@ -467,14 +567,25 @@ CirFraigCmd::exec(const string& option)
    vector<string> options;
    CmdExec::lexOptions(option, options);
 
-   if (!options.empty())
-      return CmdExec::errorOption(CMD_OPT_EXTRA, options[0]);
+   int numThreads = 0;
+   for (size_t i = 0, n = options.size(); i < n; ++i) {
+      if (myStrNCmp("-Threads", options[i], 2) == 0) {
+         if (numThreads)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!myStr2Int(options[i], numThreads) || numThreads < 1 || numThreads > 256)
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+      }
+      else
+         return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+   }
 
    if (curCmd != CIRSIMULATE) {
       cerr << "Error: circuit is not yet simulated!!" << endl;
       return CMD_EXEC_ERROR;
    }
-   cirMgr->fraig();
+   cirMgr->fraig(numThreads);
    curCmd = CIRFRAIG;
 
    return CMD_EXEC_DONE;
@@ -483,7 +594,7 @@ CirFraigCmd::exec(const string& option)
 void
 CirFraigCmd::usage(ostream& os) const
 {
-   os << "Usage: CIRFraig" << endl;
+   os << "Usage: CIRFraig [-Threads (int numThreads)]" << endl;
 }
 
 void
@@ -494,7 +605,7 @@ CirFraigCmd::help() const
 }
 
 //----------------------------------------------------------------------
-//    CIRWrite [(int gateId)][-Output (string aagFile)]
+//    CIRWrite [(int gateId)][-Output (string aagFile)]  (binary AIGER if it ends with .aig)
 //----------------------------------------------------------------------
 CmdExecStatus
 CirWriteCmd::exec(const string& option)
@@ -511,7 +622,7 @@ CirWriteCmd::exec(const string& option)
       cirMgr->writeAag(cout);
       return CMD_EXEC_DONE;
    }
-   bool hasFile = false;
+   bool hasFile = false, doBinary = false;
    int gateId;
    CirGate *thisGate = NULL;
    ofstream outfile;
@@ -521,10 +632,12 @@ CirWriteCmd::exec(const string& option)
             return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
          if (++i == n)
             return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
-         outfile.open(options[i].c_str(), ios::out);
+         outfile.open(options[i].c_str(), ios::out | ios::binary);
          if (!outfile)
             return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, options[1]);
          hasFile = true;
+         doBinary = options[i].size() > 4 &&
+                    options[i].compare(options[i].size() - 4, 4, ".aig") == 0;
       }
       else if (myStr2Int(options[i], gateId) && gateId >= 0) {
          if (thisGate != NULL)
@@ -544,7 +657,8 @@ CirWriteCmd::exec(const string& option)
 
    if (!thisGate) {
       assert (hasFile);
-      cirMgr->writeAag(outfile);
+      if (doBinary) cirMgr->writeAig(outfile);
+      else cirMgr->writeAag(outfile);
    }
    else if (hasFile) cirMgr->writeGate(outfile, thisGate);
    else cirMgr->writeGate(cout, thisGate);
@@ -555,7 +669,7 @@ CirWriteCmd::exec(const string& option)
 void
 CirWriteCmd::usage(ostream& os) const
 {
-   os << "Usage: CIRWrite [(int gateId)][-Output (string aagFile)]" << endl;
+   os << "Usage: CIRWrite [(int gateId)][-Output (string aagFile | aigFile)]" << endl;
 }
 
 void
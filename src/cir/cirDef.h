@@ -16,6 +16,18 @@ using namespace std;
 
 // TODO: define your own typedef or enum
 
+// AIG literal: gate ID * 2 + inverted
+typedef unsigned CirLit;
+const CirLit CIR_NO_LIT = ~0u;  // fanin slot not used (PI, CONST, UNDEF, PO's 2nd)
+
+// Symbol name of a PI/PO: "len" chars at "pos" of CirMgr's name arena
+struct CirSymbol
+{
+    CirSymbol() : pos(0), len(0) {}
+    unsigned pos;
+    unsigned len;                // 0 if the I/O has no name
+};
+
 class CirGate;
 class CirMgr;
 class SatSolver;
@@ -10,10 +10,11 @@
 #include "cirMgr.h"
 #include "cirGate.h"
 #include "sat.h"
-#include <unordered_map>
 #include <algorithm>
 #include "util.h"
 #include <string>
+#include <thread>
+#include <atomic>
 
 using namespace std;
 
@@ -24,99 +25,192 @@ using namespace std;
 /**************************************/
 /*   Static varaibles and functions   */
 /**************************************/
+static void
+printProof(int first, int second, bool inv, bool sat)
+{
+    #ifndef noprint
+    cout<<"\33[2K\r"<<"Proving "<<first<< " = ";
+    if (inv) { cout<<"!"; }
+    cout<<second<<"..."<< (sat ? "SAT" : "UNSAT") << "!!"<<flush;
+    #endif
+}
 
-/*******************************************/
-/*   Public member functions about fraig   */
-/*******************************************/
+// Fill pattern slots num..63 of the PI words with the distance-1 neighbours
+// of the first "num" patterns (a copy with one random PI flipped)
+static void
+expandDistanceOne(vector<size_t>& piWords, int num)
+{
+    const int nPI = piWords.size();
+    if (nPI == 0 || num == 0) { return; }
+    for (int k = num; k < 64; k++) {
+        const int src  = (k - num) % num;
+        const int flip = rnGen(nPI) % nPI;
+        for (int j = 0; j < nPI; j++) {
+            size_t bit = (piWords[j] >> src & 1) ^ (j == flip);
+            piWords[j] |= bit << k; }
+    }
+}
 
-size_t
-CirMgr::StrashKey(CirGate* g) const
+// Structural hash key: the exact fanin pair, smaller literal first
+static inline unsigned long long
+strashKey(CirLit a, CirLit b)
 {
-    size_t x = g->_fanin1.first->_ID * 2 + g->_fanin1.second;
-    size_t y = g->_fanin2.first->_ID * 2 + g->_fanin2.second;
-    return 0.5*std::max(x,y)*(std::max(x,y)+1)+std::min(x,y);
+    if (a > b) { swap(a, b); }
+    return (unsigned long long)a << 32 | b;
 }
 
+static inline size_t
+strashHome(unsigned long long key, size_t mask)
+{
+    return size_t((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+/*******************************************/
+/*   Public member functions about fraig   */
+/*******************************************/
+
 // _floatList may be changed.
 // _unusedList and _undefList won't be changed
+// The strash table is kept across commands, so an AIG is merged into the one
+// it finds only if that gate was kept earlier in this pass, i.e. it precedes
+// the AIG in _dfsList
 void
 CirMgr::strash()
 {
-    unordered_map<size_t, CirGate*> Hash;
     int original_A = A;
-    for (auto iter = _dfsList.begin(); iter != _dfsList.end(); iter++) {
-        if ((*iter)->_TYPE == 'A') {
-            auto n = Hash.find(StrashKey(*iter));
-            if (n != Hash.end()) { // merge(*iter, n->second)
-                (*iter)->_fanin1.first->_fanoutList.erase((*iter)->_ID);
-                (*iter)->_fanin2.first->_fanoutList.erase((*iter)->_ID);
-                for (auto it = (*iter)->_fanoutList.begin(); it != (*iter)->_fanoutList.end(); it++) {
-                    if (it->second.first->_fanin1.first->_ID == (*iter)->_ID)
-                        it->second.first->_fanin1.first = n->second;
-                    if (it->second.first->_fanin2.first && it->second.first->_fanin2.first->_ID == (*iter)->_ID)
-                        it->second.first->_fanin2.first = n->second;
-                    if (it->second.first->_TYPE == 'O')
-                        it->second.first->_INDEX = n->second->_ID * 2 + it->second.first->_fanin1.second;
-                    n->second->_fanoutList.insert(*it);
-                }
-                A--;
-                _gateList.erase((*iter)->_ID);
-                _floatList.erase((*iter)->_ID);
-                #ifndef noprint
-                cout<<"Strashing: "<<n->second->_ID<<" merging "<<(*iter)->_ID<<"..."<<endl;
-                #endif
-                delete *iter; *iter = 0;
-            }
-            else { Hash.insert(make_pair(StrashKey(*iter),*iter)); }
+    for (auto id : _dfsList) {
+        if (_gateType[id] != 'A') { continue; }
+        int n = strashFind(_faninLit[2*id], _faninLit[2*id+1]);
+        if (n >= 0 && n != id && _visitStamp[n] == _travId && _dfsPos[n] < _dfsPos[id]) {
+            mergeGate(_gateList[id], n * 2);
+            A--;
+            _floatList.erase(id);
+            #ifndef noprint
+            cout<<"Strashing: "<<n<<" merging "<<id<<"..."<<endl;
+            #endif
         }
+        else { strashInsert(id, true); }
     }
     if (A != original_A) {
-        _dfsList.clear();
-        for (auto iter = _gateList.begin(); iter != _gateList.end(); iter++) { iter->second->_visited = false; }
-        for (auto iter = _poList.begin(); iter != _poList.end(); iter++) { dfsTraversal(*iter); }
+        updateDfsList();
     }
 }
 
+// AIG with fanins "a" and "b" (either order) in the strash table, -1 if none
+int
+CirMgr::strashFind(CirLit a, CirLit b) const
+{
+    if (_strashGate.empty()) { return -1; }
+    const unsigned long long key = strashKey(a, b);
+    const size_t mask = _strashGate.size() - 1;
+    for (size_t i = strashHome(key, mask); _strashGate[i] >= 0; i = (i + 1) & mask)
+        if (_strashKey[i] == key) { return _strashGate[i]; }
+    return -1;
+}
+
+// Enter AIG "id" under its current fanins; an AIG already there is kept
+// unless "replace"
 void
-CirMgr::fraig()
+CirMgr::strashInsert(int id, bool replace)
 {
-    if (_fecList.empty()) { return; }
+    if (2 * (_strashCount + 1) > _strashGate.size()) {
+        vector<unsigned long long> oldKey;
+        vector<int> oldGate;
+        oldKey.swap(_strashKey);
+        oldGate.swap(_strashGate);
+        size_t size = 16;
+        while (size < 4 * (_strashCount + 1)) { size <<= 1; }
+        _strashKey.assign(size, 0);
+        _strashGate.assign(size, -1);
+        for (size_t i = 0, mask = size - 1; i < oldGate.size(); i++) {
+            if (oldGate[i] < 0) { continue; }
+            size_t j = strashHome(oldKey[i], mask);
+            while (_strashGate[j] >= 0) { j = (j + 1) & mask; }
+            _strashKey[j] = oldKey[i];
+            _strashGate[j] = oldGate[i]; }
+    }
+    const unsigned long long key = strashKey(_faninLit[2*id], _faninLit[2*id+1]);
+    const size_t mask = _strashGate.size() - 1;
+    size_t i = strashHome(key, mask);
+    for (; _strashGate[i] >= 0; i = (i + 1) & mask)
+        if (_strashKey[i] == key) {
+            if (replace) { _strashGate[i] = id; }
+            return; }
+    _strashKey[i] = key;
+    _strashGate[i] = id;
+    _strashCount++;
+}
+
+// Remove AIG "id", found under its current fanins, if it is the entry there.
+// Later entries of the probe run are shifted back instead of leaving a
+// tombstone.
+void
+CirMgr::strashErase(int id)
+{
+    if (_strashGate.empty()) { return; }
+    const unsigned long long key = strashKey(_faninLit[2*id], _faninLit[2*id+1]);
+    const size_t mask = _strashGate.size() - 1;
+    size_t i = strashHome(key, mask);
+    for (; _strashGate[i] >= 0; i = (i + 1) & mask)
+        if (_strashKey[i] == key) { break; }
+    if (_strashGate[i] != id) { return; }
+    _strashGate[i] = -1;
+    _strashCount--;
+    for (size_t j = (i + 1) & mask; _strashGate[j] >= 0; j = (j + 1) & mask) {
+        size_t h = strashHome(_strashKey[j], mask);
+        if (i < j ? (h > i && h <= j) : (h > i || h <= j)) { continue; } // in place
+        _strashKey[i] = _strashKey[j];
+        _strashGate[i] = _strashGate[j];
+        _strashGate[j] = -1;
+        i = j; }
+}
+
+// "threads" > 0 selects fraigParallel() with that many threads
+void
+CirMgr::fraig(int threads)
+{
+    if (numFEC() == 0) { return; }
     if (fraiged) { return; }
+    if (threads > 0) {
+        fraigParallel(threads);
+        finishFraig();
+        return; }
     SatSolver solver;
     solver.initialize();
     genProofModel(solver);
+    if (_simThreads > 1) { buildLevels(); }
+    resetSimCone();
     int effort = 0;
 
-    while (!_fecList.empty())
+    while (numFEC() != 0)
     {
         if (effort > 2000) { break; }
-        int num = 0;
-        vector<string> input;
+        int num = 0;                        // counterexamples in cex
+        vector<size_t> cex(I, 0);           // bit k of word j: PI j of counterexample k
         bool skip_zero  = false; // Waiting for simulation
         bool skip_first = false; // Waiting for simulation
 
-        for (auto gate : _dfsList) { gate->_fraiged = false; }
+        for (auto id : _dfsList) { _gateList[id]->_fraiged = false; }
 
-        for (auto gate : _dfsList) {
-            if (gate->_TYPE != 'A')  { continue; }
-            if (!gate->_gatefecList) { continue; }
+        for (auto id : _dfsList) {
+            if (_gateType[id] != 'A') { continue; }
+            CirGate* gate = _gateList[id];
+            const int c = _fecClass[id];
+            if (c < 0)               { continue; }
             if (gate->_fraiged)      { continue; } // Waiting for simulation
             if (gate->_removed)      { continue; } // Waiting for merge
 
-            if (gate->_gatefecList->begin()->first == 0) {
+            if (_fecMember[_fecStart[c]] == 0) {
                 if (skip_zero) { continue; }
                 if (!proof(solver, _gateList[0], gate)) { // UNSAT
-                    _mergeList.push_back({_gateList[0], {gate, gate->_value}});
+                    _mergeList.push_back({_gateList[0], {gate, simValue(gate->_ID) != 0}});
                     gate->_removed = true;
-                    gate->_gatefecList->erase(gate->_ID);
-                    gate->_gatefecList = 0;
+                    _fecClass[gate->_ID] = -1;
                     effort = 0; }
                 else { // SAT
-                    string str;
+                    for (int j = 0; j < I; j++)
+                        cex[j] |= size_t(solver.getValue(_piList[j]->getVar()) == 1) << num;
                     num++;
-                    for (auto input_gate : _piList) {
-                        str += to_string(solver.getValue(input_gate->getVar())); }
-                    input.push_back(str);
                     skip_zero = true;
                     effort++;
                     if (num == 64) { break; }
@@ -124,34 +218,32 @@ CirMgr::fraig()
                 continue;
             }
 
-            for (auto iter : *(gate->_gatefecList)) {
-                if (skip_first) { iter.second.first->_fraiged = true; continue; }
-                if (iter.second.first->_fraiged) { continue; }
-                if (iter.first == gate->_ID) { continue; }
-                if (!proof(solver, gate, iter.second.first)) { // UNSAT
+            // Members merged in this pass stay in the class (marked _removed)
+            // until the next store_FEC(), so the class can be walked while merging
+            for (int i = _fecStart[c]; i < _fecStart[c+1]; i++) {
+                if (_gateArena[_fecMember[i]]._removed) { continue; } // merged
+                CirGate* member = _gateList[_fecMember[i]];
+                if (skip_first) { member->_fraiged = true; continue; }
+                if (member->_fraiged) { continue; }
+                if (member == gate) { continue; }
+                if (!proof(solver, gate, member)) { // UNSAT
                     // avoid merging self.fanin + self -> self because self.fanin.fanout = self
-                    if (gate->_fanin1.first->_ID == iter.second.first->_ID) {
-                        CirGate* temp = gate->_fanin1.first;
-                        iter.second.first = gate;
-                        gate = temp; }
-                    else if (gate->_fanin2.first->_ID == iter.second.first->_ID) {
-                        CirGate* temp = gate->_fanin2.first;
-                        iter.second.first = gate;
+                    if (_faninLit[2*gate->_ID]/2 == (CirLit)member->_ID ||
+                        _faninLit[2*gate->_ID+1]/2 == (CirLit)member->_ID) {
+                        CirGate* temp = member;
+                        member = gate;
                         gate = temp; }
 
-                    _mergeList.push_back({gate, {iter.second.first, iter.second.first->_value != gate->_value}});
-                    iter.second.first->_removed = true;
-                    gate->_gatefecList->erase(iter.second.first->_ID);
-                    iter.second.first->_gatefecList = 0;
+                    _mergeList.push_back({gate, {member, simValue(member->_ID) != simValue(gate->_ID)}});
+                    member->_removed = true;
+                    _fecClass[member->_ID] = -1;
                     effort = 0;
                 }
                 else {
-                    string str;
+                    for (int j = 0; j < I; j++)
+                        cex[j] |= size_t(solver.getValue(_piList[j]->getVar()) == 1) << num;
                     num++;
-                    for (auto input_gate : _piList)
-                        str += to_string(solver.getValue(input_gate->getVar()));
-                    input.push_back(str);
-                    iter.second.first->_fraiged = true;
+                    member->_fraiged = true;
                     gate->_fraiged = true;
                     skip_first = true;
                     effort++;
@@ -161,79 +253,257 @@ CirMgr::fraig()
             skip_first = false;
         }
         sim:;
-        if (!input.empty()) {
-            int _size = satUpdate(input, input.size());
+        if (num != 0) {
+            expandDistanceOne(cex, num);
+            int _size = satUpdate(cex);
             #ifndef noprint
             cout<<"\33[2K\r"<<"Updating by SAT... Total #FEC Group = "<<_size<<endl;
             #endif
-            input.clear(); }
-        else { if (_fecList.size() != 0) { _fecList.clear(); } }
+        }
+        else { _fecMember.clear(); _fecStart.assign(1, 0); }
     }
-    for (auto gate : _dfsList) { gate->_gatefecList = 0; } // for safety purpose
-    mergeResult();
-    for (auto iter = _gateList.begin(); iter != _gateList.end(); iter++) { // update _notusedList
-        if (iter->second->_fanoutList.empty() && iter->second->_TYPE != 'O' && iter->second->_TYPE != 'C')
-            _notusedList.insert(iter->second->_ID);
+    finishFraig();
+}
+
+// Each round orders the FEC classes by their topologically first member and
+// cuts them into batches of batchSize classes. Waves of waveSize batches run
+// on "nThread" threads, each batch on its own solver holding only the fanin
+// cones of its members, where gates merged by earlier waves are replaced by
+// what they were merged into. A class is proven against its first member and
+// stops at its first SAT. Batches and waves do not depend on nThread and the
+// results are applied in their order, so neither does the outcome.
+void
+CirMgr::fraigParallel(int nThread)
+{
+    const int batchSize = 16, waveSize = 16;
+    vector<int> order(_gateList.size(), 0); // DFS position, CONST first
+    for (size_t i = 0; i < _dfsList.size(); i++) { order[_dfsList[i]] = i + 1; }
+    order[0] = 0;
+    vector<int> piIndex(_gateList.size(), -1);
+    for (int j = 0; j < I; j++) { piIndex[_piList[j]->_ID] = j; }
+    vector<CirLit> mergedTo(_gateList.size(), CIR_NO_LIT);
+    auto resolve = [&](CirLit lit) {
+        while (mergedTo[lit/2] != CIR_NO_LIT) { lit = mergedTo[lit/2] ^ (lit & 1); }
+        return lit; };
+
+    struct ClassResult {
+        int rep;                        // first live member
+        vector<pair<int,bool>> merged;  // UNSAT members, inverted to rep or not
+        int satMember;                  // -1 if no member is SAT
+        bool satInv;
+        vector<int> cexOnes;            // PIs at 1 in the counterexample
+    };
+    // Per-thread scratch, kept over all waves; var[] is reset over the cone
+    struct Scratch {
+        vector<Var> var;                // gate -> solver variable, -1 if none
+        vector<int> cone, stack;
+    };
+    vector<Scratch> scratch(nThread);
+    int effort = 0;
+
+    while (numFEC() != 0)
+    {
+        if (effort > 2000) { break; }
+        const int nClass = numFEC();
+        vector<ClassResult> result(nClass);
+        vector<pair<int,int>> byRep;    // (DFS position of rep, class)
+        for (int c = 0; c < nClass; c++) {
+            ClassResult& r = result[c];
+            r.rep = -1;
+            r.satMember = -1;
+            for (int i = _fecStart[c]; i < _fecStart[c+1]; i++) {
+                int id = _fecMember[i];
+                if (_gateArena[id]._removed) { continue; }
+                if (r.rep < 0 || order[id] < order[r.rep]) { r.rep = id; } }
+            if (r.rep >= 0) { byRep.push_back({order[r.rep], c}); }
+        }
+        sort(byRep.begin(), byRep.end());
+        const int nBatch = (byRep.size() + batchSize - 1) / batchSize;
+        int nSat = 0;
+
+        for (int wave = 0; wave < nBatch; wave += waveSize) {
+            const int waveEnd = std::min(wave + waveSize, nBatch);
+            atomic<int> next(wave);
+            auto work = [&](int t) {
+                vector<Var>& var = scratch[t].var;
+                vector<int>& cone = scratch[t].cone;
+                vector<int>& stack = scratch[t].stack;
+                if (var.empty()) { var.assign(_gateList.size(), -1); }
+                for (int k = next++; k < waveEnd; k = next++) {
+                    const int first = k * batchSize, last = std::min(first + batchSize, (int)byRep.size());
+
+                    // Load the fanin cones of the live members
+                    SatSolver solver;
+                    solver.initialize();
+                    cone.clear();
+                    for (int x = first; x < last; x++) {
+                        const int c = byRep[x].second;
+                        for (int i = _fecStart[c]; i < _fecStart[c+1]; i++) {
+                            int id = _fecMember[i];
+                            if (_gateArena[id]._removed || var[id] >= 0) { continue; }
+                            var[id] = solver.newVar();
+                            stack.push_back(id);
+                            while (!stack.empty()) {
+                                int g = stack.back();
+                                stack.pop_back();
+                                cone.push_back(g);
+                                if (_gateType[g] != 'A') { continue; }
+                                for (int j = 0; j < 2; j++) {
+                                    int f = resolve(_faninLit[2*g+j]) / 2;
+                                    if (var[f] < 0) { var[f] = solver.newVar(); stack.push_back(f); } }
+                            }
+                        }
+                    }
+                    for (auto g : cone) {
+                        if (_gateType[g] == 'A') {
+                            CirLit in1 = resolve(_faninLit[2*g]), in2 = resolve(_faninLit[2*g+1]);
+                            solver.addAigCNF(var[g], var[in1/2], in1 & 1, var[in2/2], in2 & 1); }
+                        else if (_gateType[g] != 'I') // CONST and UNDEF are 0
+                            solver.addAigCNF(var[g], var[g], 0, var[g], 1);
+                    }
+
+                    for (int x = first; x < last; x++) {
+                        const int c = byRep[x].second;
+                        ClassResult& r = result[c];
+                        for (int i = _fecStart[c]; i < _fecStart[c+1]; i++) {
+                            int id = _fecMember[i];
+                            if (id == r.rep || _gateArena[id]._removed) { continue; }
+                            bool inv = simValue(id) != simValue(r.rep);
+                            Var p = solver.newVar();
+                            solver.addMiterCNF(p, var[r.rep], false, var[id], inv);
+                            solver.assumeRelease();
+                            solver.assumeProperty(p, true);
+                            bool sat = solver.assumpSolve();
+                            solver.assertProperty(p, false); // retire the miter
+                            if (!sat) {
+                                solver.assertEquivalence(var[r.rep], false, var[id], inv);
+                                r.merged.push_back({id, inv});
+                                continue; }
+                            r.satMember = id;
+                            r.satInv = inv;
+                            for (auto g : cone)
+                                if (_gateType[g] == 'I' && solver.getValue(var[g]) == 1) { r.cexOnes.push_back(piIndex[g]); }
+                            break;
+                        }
+                    }
+                    for (auto g : cone) { var[g] = -1; }
+                }
+            };
+            vector<thread> pool;
+            for (int t = 1; t < nThread && t < waveEnd - wave; t++) { pool.emplace_back(work, t); }
+            work(0);
+            for (auto& th : pool) { th.join(); }
+
+            // Coordinator: record the merges of this wave for the next ones
+            for (int x = wave * batchSize; x < std::min(waveEnd * batchSize, (int)byRep.size()); x++) {
+                ClassResult& r = result[byRep[x].second];
+                for (auto& m : r.merged) {
+                    printProof(r.rep, m.first, m.second, false);
+                    _mergeList.push_back({_gateList[r.rep], {_gateList[m.first], m.second}});
+                    _gateList[m.first]->_removed = true;
+                    mergedTo[m.first] = r.rep * 2 + m.second;
+                    effort = 0; }
+                if (r.satMember >= 0) {
+                    printProof(r.rep, r.satMember, r.satInv, true);
+                    nSat++;
+                    effort++; }
+            }
+        }
+        if (nSat == 0) { _fecMember.clear(); _fecStart.assign(1, 0); continue; }
+
+        // Simulate the counterexamples 64 at a time
+        vector<size_t> cex(I, 0);
+        int num = 0;
+        for (int c = 0; c <= nClass; c++) {
+            if (c < nClass) {
+                if (result[c].satMember < 0) { continue; }
+                for (auto j : result[c].cexOnes) { cex[j] |= size_t(1) << num; }
+                if (++num < 64) { continue; } }
+            else if (num == 0) { break; }
+            else { expandDistanceOne(cex, num); }
+            int _size = satUpdate(cex);
+            #ifndef noprint
+            cout<<"\33[2K\r"<<"Updating by SAT... Total #FEC Group = "<<_size<<endl;
+            #endif
+            cex.assign(I, 0);
+            num = 0;
+        }
     }
-    fraiged = true;
 }
 
 /********************************************/
 /*   Private member functions about fraig   */
 /********************************************/
+// Drop what is left of the FEC classes and apply the merges
 void
-CirMgr::genProofModel(SatSolver& s)
+CirMgr::finishFraig()
 {
-    _gateList[0]->setVar(s.newVar());
-    s.addAigCNF(_gateList[0]->getVar(), _gateList[0]->getVar(), 0, _gateList[0]->getVar(), 1); // CONST 0
-
-    for (auto gate : _piList) { // Ensure pi cannot reach from po have Var, so fraig sat sim traverse pi list won't go wrong
-        Var v = s.newVar();
-        gate->setVar(v);
+    syncSimValues();
+    store_FEC(); // drop merged gates from what is left
+    for (auto id : _dfsList) { _fecClass[id] = -1; } // for safety purpose
+    mergeResult();
+    for (auto gate : _gateList) { // update _notusedList
+        if (gate && gate->_fanoutList.empty() && _gateType[gate->_ID] != 'O' && _gateType[gate->_ID] != 'C')
+            _notusedList.insert(gate->_ID);
     }
+    fraiged = true;
+}
+
+// Only PIs get a Var up front (fraig reads every PI of a SAT model); the
+// rest is encoded cone by cone by loadCone()
+void
+CirMgr::genProofModel(SatSolver& s)
+{
+    for (auto& gate : _gateArena) { gate.setVar(-1); }
+    for (auto gate : _piList) { gate->setVar(s.newVar()); }
+}
 
-    for (auto gate : _dfsList) {
-        if (gate->_TYPE == 'A') {
-            Var v = s.newVar();
-            gate->setVar(v);
-            s.addAigCNF(gate->getVar(), gate->_fanin1.first->getVar(), gate->_fanin1.second,
-                               gate->_fanin2.first->getVar(), gate->_fanin2.second);
-            continue; }
-        if (gate->_TYPE == 'U') { // Set to CONST 0
-            Var v = s.newVar();
-            gate->setVar(v);
-            s.addAigCNF(gate->getVar(), gate->getVar(), 0, gate->getVar(), 1); }
+// Encode the part of the fanin cone of gate "id" that is not in "s" yet
+void
+CirMgr::loadCone(SatSolver& s, int id)
+{
+    if (_gateArena[id].getVar() >= 0) { return; }
+    vector<int> stack(1, id);
+    _gateArena[id].setVar(s.newVar());
+    while (!stack.empty()) {
+        int g = stack.back();
+        stack.pop_back();
+        Var v = _gateArena[g].getVar();
+        if (_gateType[g] == 'A') {
+            CirLit in1 = _faninLit[2*g], in2 = _faninLit[2*g+1];
+            for (auto gate : {litGate(in1), litGate(in2)}) {
+                if (gate->getVar() < 0) {
+                    gate->setVar(s.newVar());
+                    stack.push_back(gate->_ID); } }
+            s.addAigCNF(v, litGate(in1)->getVar(), in1 & 1, litGate(in2)->getVar(), in2 & 1); }
+        else if (_gateType[g] != 'I') // CONST and UNDEF are 0
+            s.addAigCNF(v, v, 0, v, 1);
     }
 }
 
 bool
 CirMgr::proof(SatSolver& solver, CirGate* first, CirGate* second)
 {
-    bool inv = first->_value != second->_value;
+    bool inv = simValue(first->_ID) != simValue(second->_ID);
+    loadCone(solver, first->_ID);
+    loadCone(solver, second->_ID);
     Var newV = solver.newVar();
-    solver.addXorCNF(newV, first->getVar(), false, second->getVar(), inv);
+    solver.addMiterCNF(newV, first->getVar(), false, second->getVar(), inv);
     solver.assumeRelease();
     solver.assumeProperty(newV, true);
     bool result = solver.assumpSolve();
-
-    #ifndef noprint
-    cout<<"\33[2K\r"<<"Proving "<<first->_ID<< " = ";
-    if (inv) { cout<<"!"; }
-    cout<<second->_ID<<"..."<< (result ? "SAT" : "UNSAT") << "!!"<<flush;
-    #endif
+    solver.assertProperty(newV, false); // retire the miter
+    if (!result) { solver.assertEquivalence(first->getVar(), false, second->getVar(), inv); }
+    printProof(first->_ID, second->_ID, inv, result);
     return result;
 }
 
+// Simulate one word of bit-packed patterns, PI j taking piWords[j]
 int
-CirMgr::satUpdate(vector<string>& input, int num)
+CirMgr::satUpdate(const vector<size_t>& piWords)
 {
-    int j = 0;
-    for (auto iter = _piList.begin(); iter != _piList.end(); iter++) {
-        string value = "";
-        for (int i = num-1; i >= 0; i--) { value += input[i][j]; }
-        (*iter)->_value = stoull(value, nullptr, 2);
-        j++; }
-    int _size = Simulate(false, input, num);
+    for (int j = 0; j < I; j++) { _simValue[_piList[j]->_ID * _simWords] = piWords[j]; }
+    int _size = Simulate(64);
     store_FEC();
     return _size;
 }
@@ -243,41 +513,23 @@ CirMgr::mergeResult()
 {
     int original_A = A;
     for (auto iter = _mergeList.begin(); iter != _mergeList.end(); iter++) {
-        iter->second.first->_fanin1.first->_fanoutList.erase(iter->second.first->_ID);
-        iter->second.first->_fanin2.first->_fanoutList.erase(iter->second.first->_ID);
-        for (auto it : iter->second.first->_fanoutList) {
-            if (it.second.first->_fanin1.first->_ID == iter->second.first->_ID) {
-                it.second.first->_fanin1.first = iter->first;
-                it.second.first->_fanin1.second ^= iter->second.second;
-            }
-            if (it.second.first->_fanin2.first && it.second.first->_fanin2.first->_ID == iter->second.first->_ID) {
-                it.second.first->_fanin2.first = iter->first;
-                it.second.first->_fanin2.second ^= iter->second.second;
-            }
-            if (it.second.first->_TYPE == 'O')
-                it.second.first->_INDEX = iter->first->_ID * 2 + it.second.first->_fanin1.second;
-
-            iter->first->_fanoutList.insert({it.first, make_pair(it.second.first, it.second.second ^ iter->second.second)});
-        }
+        mergeGate(iter->second.first, iter->first->_ID * 2 + iter->second.second);
         A--;
-        _gateList.erase(iter->second.first->_ID);
-        iter->second.first->_gatefecList = 0;
+        _fecClass[iter->second.first->_ID] = -1;
 
         #ifndef noprint
         cout<<"Fraig: "<<iter->first->_ID<<" merging ";
         if (iter->second.second) { cout<<"!"; }
         cout<<iter->second.first->_ID<<"..."<<endl;
         #endif
-        delete iter->second.first; iter->second.first = 0;
+        iter->second.first = 0;
     }
 
     if (A != original_A) {
-        _dfsList.clear();
-        for (auto iter = _gateList.begin(); iter != _gateList.end(); iter++) { iter->second->_visited = false; }
-        for (auto iter = _poList.begin(); iter != _poList.end(); iter++) { dfsTraversal(*iter); }
+        updateDfsList();
         _mergeList.clear();
         #ifndef noprint
-        cout<<'\r'<<"Updating by UNSAT... Total #FEC Group = "<<_fecList.size()<<endl;
+        cout<<'\r'<<"Updating by UNSAT... Total #FEC Group = "<<numFEC()<<endl;
         #endif
     }
 }
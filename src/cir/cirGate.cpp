@@ -24,32 +24,113 @@ using namespace std;
 
 extern CirMgr *cirMgr;
 
+/********************************************/
+/*   class CirFanoutPool member functions   */
+/********************************************/
+int CirFanoutPool::sizeClass(unsigned cap)
+{
+    int k = 0;
+    while ((1u << k) < cap) { k++; }
+    return k;
+}
+
+CirLit* CirFanoutPool::alloc(unsigned cap)
+{
+    lock_guard<mutex> guard(_lock);
+    const int k = sizeClass(cap);
+    if (_free[k]) {
+        CirLit* block = _free[k];
+        _free[k] = *reinterpret_cast<CirLit**>(block);
+        return block; }
+    if (_slabUsed + cap > _slabSize) {
+        _slabSize = std::max<size_t>(cap, 1 << 16);
+        _slabs.push_back(new CirLit[_slabSize]);
+        _slabUsed = 0; }
+    CirLit* block = _slabs.back() + _slabUsed;
+    _slabUsed += cap;
+    return block;
+}
+
+void CirFanoutPool::release(CirLit* block, unsigned cap)
+{
+    lock_guard<mutex> guard(_lock);
+    const int k = sizeClass(cap);
+    *reinterpret_cast<CirLit**>(block) = _free[k];
+    _free[k] = block;
+}
+
+/********************************************/
+/*   class CirFanoutList member functions   */
+/********************************************/
+void CirFanoutList::reserve(unsigned n, CirFanoutPool& pool)
+{
+    if (n <= _cap) { return; }
+    unsigned cap = _cap;
+    while (cap < n) { cap *= 2; }
+    CirLit* heap = pool.alloc(cap);
+    copy(begin(), end(), heap);
+    if (_cap > 2) { pool.release(_heap, _cap); }
+    _heap = heap;
+    _cap = cap;
+}
+
+void CirFanoutList::insert(CirLit lit, CirFanoutPool& pool)
+{
+    reserve(_size + 1, pool);
+    CirLit* d = data();
+    unsigned i = _size;
+    while (i > 0 && d[i-1]/2 > lit/2) { d[i] = d[i-1]; i--; }
+    d[i] = lit;
+    _size++;
+}
+
+void CirFanoutList::erase(int id)
+{
+    CirLit* d = data();
+    _size = remove_if(d, d + _size, [id](CirLit f) { return f/2 == (CirLit)id; }) - d;
+}
+
+// Append "l" and merge the two sorted runs; equal IDs keep this list first
+void CirFanoutList::merge(const CirFanoutList& l, CirLit inv, CirFanoutPool& pool)
+{
+    reserve(_size + l._size, pool);
+    CirLit* d = data();
+    unsigned n = _size;
+    for (CirLit f : l) { d[_size++] = f ^ inv; }
+    inplace_merge(d, d + n, d + _size, [](CirLit a, CirLit b) { return a/2 < b/2; });
+}
+
 /**************************************/
 /*   class CirGate member functions   */
 /**************************************/
+char CirGate::getType() const { return _mgr->gateType(_ID); }
+
+string CirGate::getTypeStr() const
+{
+    switch (getType()) {
+        case 'C': return "CONST";
+        case 'U': return "UNDEF";
+        case 'A': return "AIG";
+        case 'I': return "PI";
+        case 'O': return "PO";
+        default: return "ERROR"; }
+}
+
+size_t CirGate::getValue() const { return _mgr->simValue(_ID); }
+
 void CirGate::reportGate() const
 {
     cout<<"================================================================================"<<endl;
     string str = "= " + getTypeStr() + "(" + to_string(_ID) + ")";
-    if (!_NAME.empty()) { str = str + "\"" + _NAME + "\""; }
+    string name = _mgr->symbolName(_ID);
+    if (!name.empty()) { str = str + "\"" + name + "\""; }
     str = str + ", line " + to_string(_LINE);
     cout<<str<<endl;
     cout<<"= FECs:";
 
-    bool invert = false;
-    if (_gatefecList) {
-        auto it = _gatefecList->find(_ID);
-        if (it != _gatefecList->end()) {
-            invert = it->second.second;
-            for (auto i : *_gatefecList) {
-                if (i.first == _ID) { continue; }
-                cout<<" ";
-                if (invert ^ i.second.second) { cout<<"!"; }
-                cout<<i.first; }
-        }
-    }
+    _mgr->printGateFECs(_ID);
     cout<<endl;
-    string v = bitset<64>(_value).to_string();
+    string v = bitset<64>(getValue()).to_string();
     cout<<"= Value: ";
     for (int i = 0; i < 56; i += 8)
         cout<<v.substr(i,8)<<"_";
@@ -66,13 +147,15 @@ void CirGate::reportFanin(int level, bool reseted, bool inverted, int indent)
     cout<<getTypeStr()<<" "<<_ID;
     if (!level) { cout<<endl; return; }
 
-    if ((find(printed.begin(), printed.end(), _ID) != printed.end()) && (_fanin1.first || _fanin2.first)) {
+    CirLit in1 = _mgr->faninLit(_ID, 0);
+    CirLit in2 = _mgr->faninLit(_ID, 1);
+    if ((find(printed.begin(), printed.end(), _ID) != printed.end()) && (in1 != CIR_NO_LIT || in2 != CIR_NO_LIT)) {
         cout<<" (*)"<<endl; return; }
     cout<<endl;
     printed.push_back(_ID);
 
-    if (_fanin1.first) { _fanin1.first->reportFanin(level-1, true, _fanin1.second, indent+1); }
-    if (_fanin2.first) { _fanin2.first->reportFanin(level-1, true, _fanin2.second, indent+1); }
+    if (in1 != CIR_NO_LIT) { _mgr->litGate(in1)->reportFanin(level-1, true, in1 & 1, indent+1); }
+    if (in2 != CIR_NO_LIT) { _mgr->litGate(in2)->reportFanin(level-1, true, in2 & 1, indent+1); }
 }
 
 void CirGate::reportFanout(int level, bool reseted, bool inverted, int indent)
@@ -84,17 +167,11 @@ void CirGate::reportFanout(int level, bool reseted, bool inverted, int indent)
     cout<<getTypeStr()<<" "<<_ID;
     if (!level) { cout<<endl; return; }
 
-    bool have_out = false;
-    for (auto iter = _fanoutList.begin(); iter != _fanoutList.end(); iter++) {
-        if ((*iter).second.first) { have_out = true; }
-    }
-    if ((find(printed.begin(), printed.end(), _ID) != printed.end()) && have_out) {
+    if ((find(printed.begin(), printed.end(), _ID) != printed.end()) && !_fanoutList.empty()) {
         cout<<" (*)"<<endl; return; }
     cout<<endl;
     printed.push_back(_ID);
 
-    for (auto iter = _fanoutList.begin(); iter != _fanoutList.end(); iter++) {
-        if ((*iter).second.first) { (*iter).second.first->reportFanout(level-1, true, (*iter).second.second, indent+1); }
-    }
+    for (CirLit f : _fanoutList) { _mgr->litGate(f)->reportFanout(level-1, true, f & 1, indent+1); }
 }
 
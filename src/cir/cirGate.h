@@ -13,9 +13,9 @@
 #include <vector>
 #include <algorithm>
 #include <iostream>
+#include <mutex>
 #include "cirDef.h"
 #include "sat.h"
-#include <map>
 
 using namespace std;
 
@@ -25,28 +25,84 @@ static vector<int> printed;
 //------------------------------------------------------------------------
 //   Define classes
 //------------------------------------------------------------------------
+// Storage of the fanout arrays that outgrow their inline slots: blocks of
+// 2^k literals carved from large slabs, a freed block goes to the free list
+// of its size for reuse. All of it is released at once with the pool.
+class CirFanoutPool
+{
+public:
+    CirFanoutPool() : _slabUsed(0), _slabSize(0) { for (auto& f : _free) { f = 0; } }
+    ~CirFanoutPool() { for (auto s : _slabs) { delete [] s; } }
+
+    CirLit* alloc(unsigned cap);           // "cap" a power of 2, >= 4
+    void release(CirLit* block, unsigned cap);
+
+private:
+    CirFanoutPool(const CirFanoutPool&);
+    static int sizeClass(unsigned cap);
+
+    mutex _lock;                           // connectCircuit() runs threads
+    vector<CirLit*> _slabs;
+    size_t _slabUsed;                      // literals used in _slabs.back()
+    size_t _slabSize;
+    CirLit* _free[32];                     // next block stored in each block
+};
+
+// Fanouts of a gate as literals fanout ID*2 + inv, sorted by fanout ID; an
+// AIG with both fanins on the gate appears twice, fanin 0 first. Most gates
+// have one or two fanouts, which are kept inline, more go to a CirFanoutPool.
+// Lists only move, their blocks belong to the pool.
+class CirFanoutList
+{
+public:
+    CirFanoutList() : _size(0), _cap(2) {}
+    CirFanoutList(CirFanoutList&& l) noexcept : _size(l._size), _cap(l._cap), _heap(l._heap) { l._size = 0; l._cap = 2; }
+    CirFanoutList& operator = (CirFanoutList&& l) noexcept {
+        _size = l._size; _cap = l._cap; _heap = l._heap; l._size = 0; l._cap = 2; return *this; }
+
+    unsigned size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    const CirLit* begin() const { return _cap > 2 ? _heap : _inline; }
+    const CirLit* end() const { return begin() + _size; }
+
+    void insert(CirLit lit, CirFanoutPool& pool);    // after equal fanout IDs
+    void erase(int id);                              // every fanout to "id"
+    void merge(const CirFanoutList& l, CirLit inv, CirFanoutPool& pool); // all of "l", ^ inv
+    void clear(CirFanoutPool& pool) { if (_cap > 2) { pool.release(_heap, _cap); } _size = 0; _cap = 2; }
+
+private:
+    CirLit* data() { return _cap > 2 ? _heap : _inline; }
+    void reserve(unsigned n, CirFanoutPool& pool);
+
+    unsigned _size;
+    unsigned _cap;
+    union {
+        CirLit _inline[2];
+        CirLit* _heap;
+    };
+};
+
+// Thin handle of a gate. The hot AIG data (type, fanin literals, visited
+// mark and simulation value) are kept by CirMgr in parallel arrays indexed
+// by gate ID; CirGate only keeps the cold per-gate information.
 class CirGate
 {
 public:
-    CirGate(int ID = 0, int LINE = 0, char TYPE = 'C', int INDEX = 0, string NAME = "") :
-        _ID(ID), _LINE(LINE), _TYPE(TYPE), _INDEX(INDEX), _NAME(NAME),
-        _visited(false), _fraiged(false), _removed(false), _value(0), _gatefecList(0) {}
+    CirGate(CirMgr* mgr = 0, int ID = 0, int LINE = 0) :
+        _mgr(mgr), _ID(ID), _LINE(LINE),
+        _fraiged(false), _removed(false) {}
+    CirGate(CirGate&&) = default;
+    CirGate& operator = (CirGate&&) = default;
     ~CirGate() {}
     friend class CirMgr;
 
     // Basic access methods
-    string getTypeStr() const {
-        switch (_TYPE) {
-            case 'C': return "CONST";
-            case 'U': return "UNDEF";
-            case 'A': return "AIG";
-            case 'I': return "PI";
-            case 'O': return "PO";
-            default: return "ERROR"; }
-    }
+    string getTypeStr() const;
+    char getType() const;
+    int getID() const { return _ID; }
     int getLineNo() const { return _LINE; }
     bool isAig() const { return false; }
-    size_t getValue() const { return _value; }
+    size_t getValue() const;
     Var getVar() const { return _var; }
     void setVar(const Var& v) { _var = v; }
 
@@ -56,22 +112,15 @@ public:
     void reportFanout(int level, bool reseted = false, bool inverted = false, int indent = 0);
 
 private:
+    CirMgr* _mgr;
     int _ID;
     int _LINE;
-    char _TYPE;
-    int _INDEX;
-    string _NAME;
-    bool _visited;
     bool _fraiged;
     bool _removed;
-    size_t _value;
 
     Var _var;
 
-    map<int,pair<CirGate*,bool>>* _gatefecList;
-    pair<CirGate*, bool> _fanin1;
-    pair<CirGate*, bool> _fanin2;
-    multimap<int, pair<CirGate*, bool>> _fanoutList;
+    CirFanoutList _fanoutList;
 };
 
 #endif // CIR_GATE_H
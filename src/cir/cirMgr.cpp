@@ -12,8 +12,14 @@
 #include <ctype.h>
 #include <cassert>
 #include <cstring>
-#include <sstream>
 #include <algorithm>
+#include <atomic>
+#include <thread>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "cirMgr.h"
 #include "cirGate.h"
 #include "util.h"
@@ -53,10 +59,120 @@ enum CirParseError {
 /**************************************/
 static unsigned lineNo = 0;
 static unsigned colNo  = 0;
-static char buf[1024];
 static string errMsg;
 static int errInt;
 static CirGate *errGate;
+static bool binary = false; // "aig" header: implicit PIs and delta-encoded AIGs
+
+// Whole design file in memory: mmap()ed if possible, else read() into _copy
+class CirDesignFile
+{
+public:
+    CirDesignFile() : _data(0), _size(0), _mapped(false) {}
+    ~CirDesignFile() { if (_mapped) { munmap((void*)_data, _size); } }
+
+    bool open(const string& fileName) {
+        int fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) { return false; }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void* p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                _data = (const char*)p; _size = st.st_size; _mapped = true;
+                madvise(p, _size, MADV_SEQUENTIAL);
+                ::close(fd); return true; } }
+        char chunk[65536];
+        for (ssize_t n; (n = ::read(fd, chunk, sizeof(chunk))) > 0;)
+            _copy.insert(_copy.end(), chunk, chunk + n);
+        ::close(fd);
+        _data = _copy.data(); _size = _copy.size();
+        return true;
+    }
+    const char* begin() const { return _data; }
+    const char* end() const { return _data + _size; }
+    size_t size() const { return _size; }
+
+private:
+    const char* _data;
+    size_t _size;
+    bool _mapped;
+    vector<char> _copy;
+};
+
+// In-place scanning of a line "s" of "len" chars (not NUL terminated)
+static inline bool
+isDigitChar(char c) { return c >= '0' && c <= '9'; }
+
+// Next word from "pos" on, as "istream >> string" would read it; "pos" is
+// moved past the word, whose length is returned (0 if there is none)
+static unsigned
+nextWord(const char* s, unsigned& pos, unsigned len, const char*& word)
+{
+    while (pos < len && isspace((unsigned char)s[pos])) { pos++; }
+    word = s + pos;
+    while (pos < len && !isspace((unsigned char)s[pos])) { pos++; }
+    return (s + pos) - word;
+}
+
+// Position of the first ' ' or '\t', "len" if none
+static unsigned
+findSpaceTab(const char* s, unsigned len)
+{
+    unsigned n = 0;
+    while (n < len && s[n] != ' ' && s[n] != '\t') { n++; }
+    return n;
+}
+
+static bool
+allDigits(const char* s, unsigned len)
+{
+    for (unsigned n = 0; n < len; n++)
+        if (!isDigitChar(s[n])) { return false; }
+    return true;
+}
+
+// Value of the digits s[0..len), -1 if it does not fit in an int
+static int
+scanInt(const char* s, unsigned len)
+{
+    long long x = 0;
+    for (unsigned n = 0; n < len; n++) {
+        x = x * 10 + (s[n] - '0');
+        if (x > INT_MAX) { return -1; } }
+    return int(x);
+}
+
+// Run "work(t)" for t = 0 .. n-1, t = 0 on the calling thread
+template <class Work>
+static void
+runThreads(int n, const Work& work)
+{
+    vector<thread> pool;
+    for (int t = 1; t < n; t++) { pool.emplace_back(work, t); }
+    work(0);
+    for (auto& th : pool) { th.join(); }
+}
+
+// Binary AIGER number: 7 bits per byte, low bits first, MSB set if more follow;
+// false if it ends early or does not fit in 32 bits
+static bool
+decodeNum(const char*& p, const char* end, unsigned& x)
+{
+    x = 0;
+    for (int shift = 0; p < end; shift += 7) {
+        unsigned char ch = *p++;
+        if (shift > 28 || (shift == 28 && (ch & 0x7f) > 0xf)) { return false; }
+        x |= unsigned(ch & 0x7f) << shift;
+        if (!(ch & 0x80)) { return true; } }
+    return false;
+}
+
+static void
+encodeNum(ostream& out, unsigned x)
+{
+    while (x & ~0x7fu) { out.put(char((x & 0x7f) | 0x80)); x >>= 7; }
+    out.put(char(x));
+}
 
 static bool
 parseError(CirParseError err)
@@ -145,294 +261,526 @@ parseError(CirParseError err)
    return false;
 }
 
+// Outcome of scanAig(): the error readAig() reports for the line, if any
+struct AigScan
+{
+    CirParseError err;
+    int word;            // word of the error, 0 for the gate literal
+    unsigned col;        // colNo, errInt and errMsg for parseError()
+    int num;
+    string msg;
+};
+
+// Check one "lhs rhs0 rhs1" line against M into "lit"; no global is touched,
+// so lines can be scanned concurrently. REDEF_GATE is left to the caller,
+// readAig() checks it right after word 0.
+static bool
+scanAig(const char* str, unsigned len, int M, int* lit, AigScan& scan)
+{
+    unsigned col = 0, wordPos = 0;
+    auto fail = [&](int word, CirParseError err, int num = 0, const string& msg = "") {
+        scan.err = err; scan.word = word; scan.col = col; scan.num = num; scan.msg = msg;
+        return false; };
+
+    if (!len) { return fail(0, MISSING_NUM, 0, "AIG gate literal ID"); }
+    for (int num = 0; num < 3; num++) {
+        if (col == len) { return fail(num, MISSING_NUM, 0, "space character"); }
+        if (str[col] == '\t') { return fail(num, MISSING_SPACE); }
+        if (num) { col++; }
+        if (col == len) { return fail(num, MISSING_NUM, 0, "AIG input literal ID"); }
+        if (str[col] == ' ') { return fail(num, EXTRA_SPACE); }
+        if (str[col] == '\t') { return fail(num, ILLEGAL_WSPACE, 9); }
+        const char* word;
+        unsigned n = nextWord(str, wordPos, len, word);
+        if (!allDigits(word, n)) { return fail(num, ILLEGAL_NUM, 0, "AIG input literal ID("+string(word, n)+")"); }
+
+        int id = lit[num] = scanInt(word, n);
+        if (id < 0) { return fail(num, ILLEGAL_NUM, 0, "AIG input literal ID("+string(word, n)+")"); }
+        if (num == 0 && (id == 0 || id == 1)) { return fail(num, REDEF_CONST, id); }
+        if (id > M*2+1) { return fail(num, MAX_LIT_ID, id); }
+        if (num == 0 && id % 2 != 0) { return fail(num, CANNOT_INVERTED, id, "AIG gate"); }
+        col += n;
+    }
+    if (col != len) { return fail(2, MISSING_NEWLINE); }
+    return true;
+}
+
+static bool
+aigError(const AigScan& scan)
+{
+    colNo = scan.col; errInt = scan.num; errMsg = scan.msg;
+    return parseError(scan.err);
+}
+
 CirGate* CirMgr::getGate(int gid)
 {
-    if (!_gateList.count(gid)) { return 0; }
+    if (gid < 0 || gid >= (int)_gateList.size()) { return 0; }
     return _gateList[gid];
 }
 
+// Construct gate "ID" in place inside _gateArena (no per-gate heap allocation)
+CirGate* CirMgr::newGate(int ID, int LINE, char TYPE)
+{
+    _gateArena[ID] = CirGate(this, ID, LINE);
+    _gateType[ID] = TYPE;
+    return _gateList[ID] = &_gateArena[ID];
+}
+
+// Detach gate "ID" from the netlist; its slot in _gateArena is left as is
+void CirMgr::removeGate(int ID)
+{
+    if (_gateType[ID] == 'A') { strashErase(ID); }
+    _gateArena[ID]._fanoutList.clear(_fanoutPool);
+    _gateList[ID] = 0;
+    _gateType[ID] = 0;
+}
+
 /**************************************************************/
 /*   class CirMgr member functions for circuit construction   */
 /**************************************************************/
-bool CirMgr::readCircuit(const string& fileName)
+// "threads" > 1 reads the AIG lines with readAigLines() and connects the
+// circuit on that many threads; "simplify" applies simplifyAigs() first
+bool CirMgr::readCircuit(const string& fileName, int threads, bool simplify)
 {
-    fstream file;
-    file.open(fileName,ios::in);
-    if (!file) { cout<<"Cannot open design \""<<fileName<<"\"!!"<<endl; return false; }
-    if (file.peek() == EOF) { lineNo = 0; errMsg = "aag"; parseError(MISSING_IDENTIFIER); return false; }
+    CirDesignFile file;
+    if (!file.open(fileName)) { cout<<"Cannot open design \""<<fileName<<"\"!!"<<endl; return false; }
+    if (!file.size()) { lineNo = 0; errMsg = "aag"; parseError(MISSING_IDENTIFIER); return false; }
 
     lineNo = 0;
-    int m,i,o,a;
-
-    while (file.getline(buf, sizeof(buf), '\n')) {
-        string str = buf;
+    int m = 0, i = 0, o = 0, a = 0;
+
+    // Lines are scanned in place; "str" is not NUL terminated
+    const char* p = file.begin();
+    const char* end = file.end();
+    while (p < end) {
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        if (!eol) { eol = end; }
+        const char* str = p;
+        unsigned len = eol - p;
+        p = (eol < end) ? eol + 1 : end;
         lineNo++;
         colNo = 0;
 
         if (lineNo == 1) {
-            if (!readHeader(str)) { return false; }
-            m = M; i = I; o = O; a = A; }
-        else if (i > 0) { if (!readInput(str))     { return false; } i--; }
-        else if (o > 0) { if (!readOutput(str, m)) { return false; } o--; }
-        else if (a > 0) { if (!readAig(str))       { return false; } a--; }
+            if (!readHeader(str, len)) { return false; }
+            m = M; i = I; o = O; a = A;
+            _piSymbol.resize(I); _poSymbol.resize(O);
+            if (binary) { // PIs are 1..I, numbered as their aag lines would be
+                for (; i > 0; i--) { _piList.push_back(newGate(I-i+1, I-i+2, 'I')); } } }
+        else if (i > 0) { if (!readInput(str, len))     { return false; } i--; }
+        else if (o > 0) { if (!readOutput(str, len, m)) { return false; } o--; }
+        else if (a > 0) { if (!readAig(str, len))       { return false; } a--; }
         else {
             bool _end = false;
-            if (!readComment(str, _end)) { return false; }
+            if (!readComment(str, len, _end)) { return false; }
             if (_end) { break; }
-            if (!readSymbol(str)) { return false; } }
+            if (!readSymbol(str, len)) { return false; } }
+
+        if (binary && i == 0 && o == 0 && a > 0) {
+            if (!readBinaryAig(p, end)) { return false; }
+            a = 0; }
+        else if (threads > 1 && i == 0 && o == 0 && a > 0) {
+            if (!readAigLines(p, end, a, threads)) { return false; } }
     }
 
     if (i) { lineNo++; errMsg = "PI";  parseError(MISSING_DEF); return false; }
     if (o) { lineNo++; errMsg = "PO";  parseError(MISSING_DEF); return false; }
     if (a) { lineNo++; errMsg = "AIG"; parseError(MISSING_DEF); return false; }
 
-    connectCircuit();
-    for (auto iter = _poList.begin(); iter != _poList.end(); iter++) { dfsTraversal(*iter); }
+    if (simplify) { simplifyAigs(); }
+    connectCircuit(threads);
+    dfsTraversal();
+    for (int id = 1; id <= M; id++)
+        if (_gateType[id] == 'A') { strashInsert(id, false); }
     fraiged = false;
     simed = false;
     return true;
 }
 
-bool CirMgr::readHeader(const string& str)
+bool CirMgr::readHeader(const char* str, unsigned len)
 {
-    if (str.find_first_not_of(' ')) { parseError(EXTRA_SPACE); return false; }
-    if (str.find_first_not_of('\t')) { errInt = 9; parseError(ILLEGAL_WSPACE); return false; }
-
-    vector<string> v;
-    splitString(str, v);
-
-    if (v[0] == "aag") { colNo = 3; }
-    else if (v[0].substr(0,3) == "aag" && isdigit(v[0][3])) { colNo = 3; parseError(MISSING_SPACE); return false; }
-    else { errMsg = v[0]; parseError(ILLEGAL_IDENTIFIER); return false; }
-
-    unsigned _size = str.size();
+    if (!len || str[0] == ' ') { parseError(EXTRA_SPACE); return false; }
+    if (str[0] == '\t') { errInt = 9; parseError(ILLEGAL_WSPACE); return false; }
 
-    vector<string> _type = {"variables", "PIs", "latches", "POs", "AIGs"};
-    for (int typenum = 0; typenum < 5;) {
-        if (colNo == _size) { errMsg = "number of "+_type[typenum]; parseError(MISSING_NUM); return false; }
+    unsigned wordPos = 0;
+    const char* word;
+    unsigned n = nextWord(str, wordPos, len, word);
+    bool aag = (n >= 3 && !strncmp(word, "aag", 3));
+    bool aig = (n >= 3 && !strncmp(word, "aig", 3));
+    if ((aag || aig) && n == 3) { colNo = 3; binary = aig; }
+    else if ((aag || aig) && n > 3 && isdigit(word[3]))
+        { colNo = 3; parseError(MISSING_SPACE); return false; }
+    else { errMsg.assign(word, n); parseError(ILLEGAL_IDENTIFIER); return false; }
+
+    static const char* _type[] = {"variables", "PIs", "latches", "POs", "AIGs"};
+    int num[5];
+    for (int typenum = 0; typenum < 5; typenum++) {
+        if (colNo == len) { errMsg = string("number of ")+_type[typenum]; parseError(MISSING_NUM); return false; }
         if (str[colNo] == '\t') { parseError(MISSING_SPACE); return false; }
         colNo++;
-        if (colNo == _size) { errMsg = "number of "+_type[typenum]; parseError(MISSING_NUM); return false; }
+        if (colNo == len) { errMsg = string("number of ")+_type[typenum]; parseError(MISSING_NUM); return false; }
         if (str[colNo] == ' ') { parseError(EXTRA_SPACE); return false; }
         if (str[colNo] == '\t') { errInt = 9; parseError(ILLEGAL_WSPACE); return false; }
-        colNo += v[++typenum].size();
-        if (v[typenum].find_first_not_of("0123456789") != string::npos) {
-            errMsg = "number of "+_type[typenum-1]+"("+v[typenum]+")"; parseError(ILLEGAL_NUM); return false; }
+        n = nextWord(str, wordPos, len, word);
+        colNo += n;
+        num[typenum] = allDigits(word, n) ? scanInt(word, n) : -1;
+        if (num[typenum] < 0) {
+            errMsg = string("number of ")+_type[typenum]+"("+string(word, n)+")"; parseError(ILLEGAL_NUM); return false; }
     }
-    if (colNo != _size) { parseError(MISSING_NEWLINE); return false; }
+    if (colNo != len) { parseError(MISSING_NEWLINE); return false; }
 
-    M = stoi(v[1]);
-    I = stoi(v[2]);
-    L = stoi(v[3]);
-    O = stoi(v[4]);
-    A = stoi(v[5]);
+    M = num[0];
+    I = num[1];
+    L = num[2];
+    O = num[3];
+    A = num[4];
 
     if (L) { errMsg = "latches"; parseError(ILLEGAL_NUM); return false; }
     if (M < (I+L+A)) { errMsg = "Number of variables"; errInt = M; parseError(NUM_TOO_SMALL); return false; }
+
+    // IDs are 0 (CONST), 1..M (PI/AIG/UNDEF) and M+1..M+O (PO)
+    _gateArena.resize(M+O+1);
+    _gateList.assign(M+O+1, 0);
+    _gateType.assign(M+O+1, 0);
+    _faninLit.assign(2*(M+O+1), CIR_NO_LIT);
+    _visitStamp.assign(M+O+1, 0);
+    _simValue.assign((M+O+1) * _simWords, 0);
+    _fecClass.assign(M+O+1, -1);
     return true;
 }
 
-bool CirMgr::readInput(const string& str)
+bool CirMgr::readInput(const char* str, unsigned len)
 {
-    if (str.empty()) { errMsg = "PI literal ID"; parseError(MISSING_NUM); return false; }
-    size_t not_int_pos = str.find_first_not_of("0123456789");
-    if (not_int_pos == string::npos) {
-        int id = stoi(str);
+    if (!len) { errMsg = "PI literal ID"; parseError(MISSING_NUM); return false; }
+    unsigned not_int_pos = 0;
+    while (not_int_pos < len && isDigitChar(str[not_int_pos])) { not_int_pos++; }
+    if (not_int_pos == len) {
+        int id = scanInt(str, len);
+        if (id < 0) { errMsg = "PI literal ID("+ string(str, len) +")"; parseError(ILLEGAL_NUM); return false; }
         if (id == 0 || id == 1) { errInt = id; parseError(REDEF_CONST); return false; }
         if (id > M*2+1) { errInt = id; parseError(MAX_LIT_ID); return false; }
         if (id % 2 != 0) { errMsg = "PI"; errInt = id; parseError(CANNOT_INVERTED); return false; }
-        auto iter = _gateList.find(id/2);
-        if (iter != _gateList.end()) { errInt = id; errGate = iter->second; parseError(REDEF_GATE); return false;}
+        if (_gateList[id/2]) { errInt = id; errGate = _gateList[id/2]; parseError(REDEF_GATE); return false;}
 
-        CirGate* p = new CirGate(id/2, lineNo, 'I', id);
-        _piList.push_back(p);
-        _gateList[id/2] = p;
+        _piList.push_back(newGate(id/2, lineNo, 'I'));
         return true; }
 
     if (str[0] == ' ') { parseError(EXTRA_SPACE); return false; }
     if (str[0] == '\t') { errInt = 9; parseError(ILLEGAL_WSPACE); return false; }
     if (str[not_int_pos] == ' ' || str[not_int_pos] == '\t') { colNo = 1; parseError(MISSING_NEWLINE); return false; }
-    else { errMsg = "PI literal ID("+ str.substr(0,str.find_first_of(" \t")) +")"; parseError(ILLEGAL_NUM); return false; }
+    else { errMsg = "PI literal ID("+ string(str, findSpaceTab(str, len)) +")"; parseError(ILLEGAL_NUM); return false; }
 }
 
-bool CirMgr::readOutput(const string& str, int& m)
+bool CirMgr::readOutput(const char* str, unsigned len, int& m)
 {
-    if (str.empty()) { errMsg = "PO literal ID"; parseError(MISSING_NUM); return false; }
-    size_t not_int_pos = str.find_first_not_of("0123456789");
-    if (not_int_pos == string::npos) {
-        int id = stoi(str);
+    if (!len) { errMsg = "PO literal ID"; parseError(MISSING_NUM); return false; }
+    unsigned not_int_pos = 0;
+    while (not_int_pos < len && isDigitChar(str[not_int_pos])) { not_int_pos++; }
+    if (not_int_pos == len) {
+        int id = scanInt(str, len);
+        if (id < 0) { errMsg = "PO literal ID("+ string(str, len) +")"; parseError(ILLEGAL_NUM); return false; }
         if (id > M*2+1) { errInt = id; parseError(MAX_LIT_ID); return false; }
 
         m++;
-        CirGate* p = new CirGate(m, lineNo, 'O', id);
-        _poList.push_back(p);
-        _gateList[m] = p;
+        _poList.push_back(newGate(m, lineNo, 'O'));
+        _faninLit[2*m] = id;
         return true; }
 
     if (str[0] == ' ') { parseError(EXTRA_SPACE); return false; }
     if (str[0] == '\t') { errInt = 9; parseError(ILLEGAL_WSPACE); return false; }
     if (str[not_int_pos] == ' ' || str[not_int_pos] == '\t') { colNo = 1; parseError(MISSING_NEWLINE); return false; }
-    else { errMsg = "PO literal ID("+ str.substr(0,str.find_first_of(" \t")) +")"; parseError(ILLEGAL_NUM); return false; }
+    else { errMsg = "PO literal ID("+ string(str, findSpaceTab(str, len)) +")"; parseError(ILLEGAL_NUM); return false; }
 }
 
-bool CirMgr::readAig(const string& str)
+bool CirMgr::readAig(const char* str, unsigned len)
 {
-    if (str.empty()) { errMsg = "AIG gate literal ID"; parseError(MISSING_NUM); return false; }
+    int lit[3];
+    AigScan scan;
+    bool ok = scanAig(str, len, M, lit, scan);
+    if (!ok && scan.word == 0) { return aigError(scan); }
+    if (_gateList[lit[0]/2] && _gateType[lit[0]/2] != 'O') {
+        errInt = lit[0]; errGate = _gateList[lit[0]/2]; parseError(REDEF_GATE); return false; }
+    if (!ok) { return aigError(scan); }
+
+    int id = lit[0]/2;
+    newGate(id, lineNo, 'A');
+    _faninLit[2*id]   = lit[1];
+    _faninLit[2*id+1] = lit[2];
+    return true;
+}
 
-    unsigned _size = str.size();
-    vector<string> v;
-    splitString(str, v);
+// Parse the "a" AIG lines at "p" on "threads" threads. The rest of the file
+// is cut into byte ranges at newlines; each thread counts the lines of its
+// range, scans those of the AIG section and claims their gate IDs. Then the
+// first bad line is reported exactly as readAig() would have, or the gates
+// are created. "p" and "a" are left past the lines read.
+bool CirMgr::readAigLines(const char*& p, const char* end, int& a, int threads)
+{
+    const int nThread = threads;
+    const unsigned base = lineNo;
+    vector<const char*> from(nThread+1, end);
+    from[0] = p;
+    for (int t = 1; t < nThread; t++) {
+        const char* q = std::max(p + (end - p) * t / nThread, from[t-1]);
+        const char* eol = (const char*)memchr(q, '\n', end - q);
+        from[t] = eol ? eol + 1 : end; }
+
+    // Pass 1: lines per range, a last line without '\n' included
+    vector<int> first(nThread+1, 0);
+    runThreads(nThread, [&](int t) {
+        int n = 0;
+        for (const char* q = from[t]; q < from[t+1]; q++) { n += (*q == '\n'); }
+        if (from[t] < from[t+1] && from[t+1][-1] != '\n') { n++; }
+        first[t+1] = n; });
+    for (int t = 0; t < nThread; t++) { first[t+1] += first[t]; }
+    const int nLine = std::min(a, first[nThread]);
+
+    // Pass 2: scan lines up to the first bad one of each range; line k claims
+    // gate lhs/2 if no earlier line has (owner holds the smallest k+1)
+    vector<int> lits(3 * nLine);
+    vector<atomic<int>> owner(M+1);
+    vector<AigScan> scan(nThread);
+    vector<int> bad(nThread, INT_MAX);
+    vector<const char*> stop(nThread, 0);
+    runThreads(nThread, [&](int t) {
+        const char* q = from[t];
+        for (int k = first[t]; k < std::min(first[t+1], nLine); k++) {
+            const char* eol = (const char*)memchr(q, '\n', from[t+1] - q);
+            if (!eol) { eol = from[t+1]; }
+            bool ok = scanAig(q, eol - q, M, &lits[3*k], scan[t]);
+            q = (eol < from[t+1]) ? eol + 1 : eol;
+            stop[t] = q;
+            if (!ok && scan[t].word == 0) { bad[t] = k; break; }
+            atomic<int>& o = owner[lits[3*k]/2];
+            int cur = o.load();
+            while ((cur == 0 || cur > k+1) && !o.compare_exchange_weak(cur, k+1)) {}
+            if (!ok) { bad[t] = k; break; }
+        } });
+
+    // Pass 3: first line of each range redefining a PI or an earlier AIG
+    vector<int> redef(nThread, INT_MAX);
+    runThreads(nThread, [&](int t) {
+        int last = std::min(std::min(first[t+1], nLine) - 1, bad[t]);
+        for (int k = first[t]; k <= last; k++) {
+            if (k == bad[t] && scan[t].word == 0) { break; }
+            int id = lits[3*k]/2;
+            if ((_gateList[id] && _gateType[id] != 'O') || owner[id].load() != k+1) { redef[t] = k; break; }
+        } });
+
+    for (int t = 0; t < nThread; t++) {
+        if (redef[t] <= bad[t] && redef[t] != INT_MAX) {
+            int k = redef[t], id = lits[3*k]/2;
+            if (!_gateList[id]) { newGate(id, base + owner[id].load(), 'A'); }
+            lineNo = base + k + 1;
+            errInt = lits[3*k]; errGate = _gateList[id]; parseError(REDEF_GATE); return false; }
+        if (bad[t] != INT_MAX) { lineNo = base + bad[t] + 1; return aigError(scan[t]); }
+    }
 
-    for (int num = 0; num < 3;) {
-        if (colNo == _size) { errMsg = "space character"; parseError(MISSING_NUM); return false; }
-        if (str[colNo] == '\t') { parseError(MISSING_SPACE); return false; }
-        if (num) { colNo++; }
-        if (colNo == _size) { errMsg = "AIG input literal ID"; parseError(MISSING_NUM); return false; }
-        if (str[colNo] == ' ') { parseError(EXTRA_SPACE); return false; }
-        if (str[colNo] == '\t') { errInt = 9; parseError(ILLEGAL_WSPACE); return false; }
-        if (v[num].find_first_not_of("0123456789") != string::npos) {
-            errMsg = "AIG input literal ID("+v[num]+")"; parseError(ILLEGAL_NUM); return false; }
+    // Pass 4: create the gates, IDs are distinct by now
+    runThreads(nThread, [&](int t) {
+        for (int k = first[t]; k < std::min(first[t+1], nLine); k++) {
+            int id = lits[3*k]/2;
+            newGate(id, base + k + 1, 'A');
+            _faninLit[2*id]   = lits[3*k+1];
+            _faninLit[2*id+1] = lits[3*k+2];
+        } });
+
+    lineNo = base + nLine;
+    for (int t = 0; t < nThread; t++)
+        if (first[t] < nLine && nLine <= first[t+1]) { p = stop[t]; }
+    a -= nLine;
+    return true;
+}
 
-        int id = stoi(v[num]);
-        if (num == 0 && (id == 0 || id == 1)) { errInt = id; parseError(REDEF_CONST); return false; }
-        if (id > M*2+1) { errInt = id; parseError(MAX_LIT_ID); return false; }
-        if (num == 0) {
-            if (id % 2 != 0) { errMsg = "AIG gate"; errInt = id; parseError(CANNOT_INVERTED); return false; }
-            auto iter = _gateList.find(id/2);
-            if (iter != _gateList.end() && iter->second->_TYPE != 'O') {
-                errInt = id; errGate = iter->second; parseError(REDEF_GATE); return false; }
-        }
-        colNo += v[num].size();
-        num++;
+// AIG k is I+k+1 with "lhs-rhs0 rhs0-rhs1" encoded by decodeNum(); "p" is
+// left after the last AIG
+bool CirMgr::readBinaryAig(const char*& p, const char* end)
+{
+    for (int k = 0; k < A; k++) {
+        lineNo++;
+        unsigned lhs = 2*(I+k+1), d0, d1;
+        if (!decodeNum(p, end, d0) || !decodeNum(p, end, d1)) { errMsg = "AIG"; parseError(MISSING_DEF); return false; }
+        if (d0 == 0 || d0 > lhs || d1 > lhs - d0) {
+            errMsg = "AIG input literal delta("+to_string(d0)+" "+to_string(d1)+")"; parseError(ILLEGAL_NUM); return false; }
+
+        newGate(I+k+1, lineNo, 'A');
+        _faninLit[2*(I+k+1)]   = lhs - d0;
+        _faninLit[2*(I+k+1)+1] = lhs - d0 - d1;
     }
-    if (colNo != _size) { parseError(MISSING_NEWLINE); return false; }
-
-    CirGate* p = new CirGate(stoi(v[0])/2, lineNo, 'A', stoi(v[0]));
-    _aigList.push_back(make_pair(p, vector<int>{stoi(v[1]), stoi(v[2])}));
-    _gateList[stoi(v[0])/2] = p;
     return true;
 }
 
-bool CirMgr::readComment(const string & str, bool& _end)
+bool CirMgr::readComment(const char* str, unsigned len, bool& _end)
 {
-    if (str == "c") { _end = true; return true; }
-    if (str[0] == 'c') { colNo = 1; parseError(MISSING_NEWLINE); return false; }
+    if (len == 1 && str[0] == 'c') { _end = true; return true; }
+    if (len && str[0] == 'c') { colNo = 1; parseError(MISSING_NEWLINE); return false; }
     return true;
 }
 
-bool CirMgr::readSymbol(const string& str)
+bool CirMgr::readSymbol(const char* str, unsigned len)
 {
-    switch (str[0]) {
+    char type = len ? str[0] : 0;
+    switch (type) {
         case (' '):  parseError(EXTRA_SPACE); return false;
         case ('\t'): errInt = 9; parseError(ILLEGAL_WSPACE); return false;
         case ('i'):  case ('o'): colNo++; break;
-        default:     errMsg = str[0]; parseError(ILLEGAL_SYMBOL_TYPE); return false; }
+        default:     errMsg = type; parseError(ILLEGAL_SYMBOL_TYPE); return false; }
 
-    if (!str[1])          { errMsg = "symbol index"; parseError(MISSING_NUM); return false; }
+    if (len < 2)          { errMsg = "symbol index"; parseError(MISSING_NUM); return false; }
     if (str[1] == ' ')    { parseError(EXTRA_SPACE); return false; }
     if (str[1] == '\t')   { errInt = 9; parseError(ILLEGAL_WSPACE); return false; }
 
-    string index_string = str.substr(1, str.find_first_of(" \t")-1);
-    if (index_string.find_first_not_of("0123456789") != string::npos)
-        { errMsg = "symbol index("+index_string+")"; parseError(ILLEGAL_NUM); return false; }
+    const char* index_str = str + 1;
+    unsigned index_len = findSpaceTab(str, len) - 1;
+    if (!allDigits(index_str, index_len))
+        { errMsg = "symbol index("+string(index_str, index_len)+")"; parseError(ILLEGAL_NUM); return false; }
 
-    colNo += index_string.size();
-    if (!str[colNo] || (str.substr(colNo).find_first_not_of(' ') == string::npos))
+    colNo += index_len;
+    unsigned rest = colNo;
+    while (rest < len && str[rest] == ' ') { rest++; }
+    if (colNo == len || rest == len)
         { errMsg = "symbolic name"; parseError(MISSING_IDENTIFIER); return false; }
     if (str[colNo] == '\t') { errMsg = "space character"; parseError(MISSING_NUM); return false; }
 
     colNo++;
-    string name = str.substr(colNo);
-    for (auto iter = name.begin(); iter != name.end(); iter++, colNo++) {
-        if (!isprint(*iter)) { errInt = int(*iter); parseError(ILLEGAL_SYMBOL_NAME); return false; }
+    const char* name = str + colNo;
+    unsigned name_len = len - colNo;
+    for (; colNo < len; colNo++) {
+        if (!isprint(str[colNo])) { errInt = int(str[colNo]); parseError(ILLEGAL_SYMBOL_NAME); return false; }
     }
 
-    int index = stoi(index_string);
-    if (str[0] == 'i') {
+    int index = scanInt(index_str, index_len);
+    if (index < 0)
+        { errMsg = "symbol index("+string(index_str, index_len)+")"; parseError(ILLEGAL_NUM); return false; }
+    CirSymbol* sym = 0;
+    if (type == 'i') {
         if (index >= I)
             { errMsg = "PI index"; errInt = index; parseError(NUM_TOO_BIG); return false; }
-        if (_piList[index]->_NAME != "")
-            { errMsg = str[0]; errInt = index; parseError(REDEF_SYMBOLIC_NAME); return false; }
-        _piList[index]->_NAME = name;
-        return true; }
-
-    if (str[0] == 'o') {
+        sym = &_piSymbol[index]; }
+    else if (type == 'o') {
         if (index >= O)
             { errMsg = "PO index"; errInt = index; parseError(NUM_TOO_BIG); return false; }
-        if (_poList[index]->_NAME != "")
-            { errMsg = str[0]; errInt = index; parseError(REDEF_SYMBOLIC_NAME); return false; }
-        _poList[index]->_NAME = name;
-        return true; }
-
-    return false;
+        sym = &_poSymbol[index]; }
+    else { return false; }
+
+    if (sym->len)
+        { errMsg = type; errInt = index; parseError(REDEF_SYMBOLIC_NAME); return false; }
+    sym->pos = _symbolArena.size();
+    sym->len = name_len;
+    _symbolArena.append(name, name_len);
+    return true;
 }
 
-void CirMgr::splitString (const string& str, vector<string>& v) const
+// Name of PI/PO "id", empty for other gates; POs are M+1..M+O, PIs are
+// looked up in _piList (only used for reporting)
+string CirMgr::symbolName(int id) const
 {
-    string t;
-    istringstream in(str);
-    while (in >> t) { v.push_back(t); }
+    const CirSymbol* sym = 0;
+    if (_gateType[id] == 'O') { sym = &_poSymbol[id - M - 1]; }
+    else if (_gateType[id] == 'I') {
+        for (unsigned k = 0; k < _piList.size(); k++)
+            if (_piList[k]->_ID == id) { sym = &_piSymbol[k]; break; } }
+    if (!sym) { return ""; }
+    return _symbolArena.substr(sym->pos, sym->len);
 }
 
-void CirMgr::connectCircuit()
+// Fanouts of gate g are appended by thread g % threads in increasing fanout
+// ID, so each _fanoutList is built exactly as a single pass would build it
+void CirMgr::connectCircuit(int threads)
 {
-    bool pushed = false;
-    _gateList[0] = new CirGate();
+    const int nThread = threads;
+    newGate(0, 0, 'C');
 
+    // A PO floats if it creates the UNDEF gate of its fanin
     for (auto iter = _poList.begin(); iter != _poList.end(); iter++) {
-        int index = (*iter)->_INDEX;
-        if (!_gateList.count(index/2)) {
-            _gateList[index/2] = new CirGate(index/2,0,'U',index);
+        CirLit lit = _faninLit[2*(*iter)->_ID];
+        if (!_gateList[lit/2]) {
+            newGate(lit/2, 0, 'U');
             _floatList.insert((*iter)->_ID); }
-        (*iter)->_fanin1.first  = _gateList[index/2];
-        (*iter)->_fanin1.second = index%2;
-        _gateList[index/2]->_fanoutList.insert({(*iter)->_ID, {*iter, index%2}});
     }
-    for (auto iter = _aigList.begin(); iter != _aigList.end(); iter++) {
-        int index0 = iter->second[0];
-        int index1 = iter->second[1];
-        if (!_gateList.count(index0/2)) {
-            _floatList.insert(iter->first->_ID);
-            pushed = true;
-            _gateList[index0/2] = new CirGate(index0/2,0,'U',index0); }
-        if (!_gateList.count(index1/2)) {
-            if (!pushed) {
-                _floatList.insert(iter->first->_ID); }
-            _gateList[index1/2] = new CirGate(index1/2,0,'U',index1); }
-        if (_gateList[index0/2]->_TYPE == 'U')
-            _floatList.insert(iter->first->_ID);
-
-        if (_gateList[index1/2]->_TYPE == 'U')
-            _floatList.insert(iter->first->_ID);
-
-        iter->first->_fanin1.first  = _gateList[index0/2];
-        iter->first->_fanin1.second = index0%2;
-        iter->first->_fanin2.first  = _gateList[index1/2];
-        iter->first->_fanin2.second = index1%2;
-
-        _gateList[iter->second[0]/2]->_fanoutList.insert({iter->first->_ID, {iter->first,index0%2}});
-        _gateList[iter->second[1]/2]->_fanoutList.insert({iter->first->_ID, {iter->first,index1%2}});
-        pushed = false;
+    for (int id = 1; id <= M; id++) {
+        if (_gateType[id] != 'A') { continue; }
+        if (!_gateList[_faninLit[2*id]/2])   { newGate(_faninLit[2*id]/2, 0, 'U'); }
+        if (!_gateList[_faninLit[2*id+1]/2]) { newGate(_faninLit[2*id+1]/2, 0, 'U'); }
     }
+    runThreads(nThread, [&](int t) {
+        for (int id = 1; id <= M; id++) {
+            if (_gateType[id] != 'A') { continue; }
+            for (int i = 0; i < 2; i++) {
+                CirLit lit = _faninLit[2*id+i];
+                if ((int)(lit/2) % nThread != t) { continue; }
+                _gateList[lit/2]->_fanoutList.insert(id*2 + lit%2, _fanoutPool); }
+        }
+        for (auto iter = _poList.begin(); iter != _poList.end(); iter++) {
+            CirLit lit = _faninLit[2*(*iter)->_ID];
+            if ((int)(lit/2) % nThread != t) { continue; }
+            _gateList[lit/2]->_fanoutList.insert((*iter)->_ID*2 + lit%2, _fanoutPool);
+        } });
+
+    // Floating AIGs and unused gates of each ID range, merged in ID order
+    const int n = _gateList.size(), chunk = (n + nThread - 1) / nThread;
+    vector<vector<int>> floating(nThread), notused(nThread);
+    runThreads(nThread, [&](int t) {
+        for (int id = t * chunk; id < std::min(n, (t+1) * chunk); id++) {
+            char type = _gateType[id];
+            if (type == 'A' && (_gateType[_faninLit[2*id]/2] == 'U' || _gateType[_faninLit[2*id+1]/2] == 'U'))
+                floating[t].push_back(id);
+            if (type && type != 'O' && type != 'C' && _gateList[id]->_fanoutList.empty())
+                notused[t].push_back(id);
+        } });
+    for (int t = 0; t < nThread; t++) {
+        for (auto id : floating[t]) { _floatList.insert(id); }
+        _notusedList.insert(notused[t].begin(), notused[t].end()); }
+}
 
-    for (auto iter = _gateList.begin(); iter != _gateList.end(); iter++) {
-        if (iter->second->_TYPE != 'O' && iter->second->_TYPE != 'C' && iter->second->_fanoutList.empty())
-            _notusedList.insert(iter->second->_ID);
-    }
+// Rebuild _dfsList from the POs: fanins in post-order, fanin 0 first. A gate
+// is visited iff its _visitStamp is the current _travId, so starting over
+// costs no clearing pass.
+void CirMgr::dfsTraversal()
+{
+    if (++_travId == 0) { _visitStamp.assign(_visitStamp.size(), 0); _travId = 1; }
+    _dfsList.clear();
+    _dfsPos.resize(_gateList.size());
+    _poDfsStart.resize(_poList.size());
+    dfsFrom(0);
 }
 
-void CirMgr::dfsTraversal(CirGate* gate)
+// Bring _dfsList up to date after mergeGate(): the traversals of the POs
+// before the first one that reached a rewired gate are unchanged, so only
+// the rest of the list is traversed again
+void CirMgr::updateDfsList()
 {
-    if (gate->_fanin1.first) {
-        if (!gate->_fanin1.first->_visited) {
-            gate->_fanin1.first->_visited = true;
-            dfsTraversal(gate->_fanin1.first); } }
+    if (_dfsDirty < 0) { return; }
+    int k = upper_bound(_poDfsStart.begin(), _poDfsStart.end(), _dfsDirty) - _poDfsStart.begin() - 1;
+    for (size_t i = _poDfsStart[k]; i < _dfsList.size(); i++) { _visitStamp[_dfsList[i]] = 0; }
+    _dfsList.resize(_poDfsStart[k]);
+    dfsFrom(k);
+}
 
-    if (gate->_fanin2.first) {
-        if (!gate->_fanin2.first->_visited) {
-            gate->_fanin2.first->_visited = true;
-            dfsTraversal(gate->_fanin2.first); } }
-    _dfsList.push_back(gate);
+// Traverse from POs "first" on, visiting only what earlier POs have not. The
+// stack holds (gate, next fanin) so deep circuits cannot overflow the call
+// stack.
+void CirMgr::dfsFrom(int first)
+{
+    vector<pair<int,int>> stack;
+    for (int k = first; k < (int)_poList.size(); k++) {
+        _poDfsStart[k] = _dfsList.size();
+        stack.push_back({_poList[k]->_ID, 0});
+        _visitStamp[_poList[k]->_ID] = _travId;
+        while (!stack.empty()) {
+            pair<int,int>& top = stack.back();
+            if (top.second == 2) {
+                _dfsPos[top.first] = _dfsList.size();
+                _dfsList.push_back(top.first);
+                stack.pop_back();
+                continue; }
+            CirLit lit = _faninLit[2*top.first + top.second++];
+            if (lit != CIR_NO_LIT && _visitStamp[lit/2] != _travId) {
+                _visitStamp[lit/2] = _travId;
+                stack.push_back({(int)(lit/2), 0}); }
+        }
+    }
+    _dfsDirty = -1;
 }
 
 /**********************************************************/
@@ -454,26 +802,28 @@ void CirMgr::printSummary() const
 void CirMgr::printNetlist() const
 {
     cout<<endl;
+    // PI names by gate ID; POs are M+1..M+O
+    vector<const CirSymbol*> piSym(M + 1, 0);
+    for (unsigned k = 0; k < _piList.size(); k++) { piSym[_piList[k]->_ID] = &_piSymbol[k]; }
+
     int i = 0;
-    for (auto iter = _dfsList.begin(); iter != _dfsList.end(); iter++) {
-        if ((*iter)->_TYPE == 'U') { continue; }
+    for (auto id : _dfsList) {
+        if (_gateType[id] == 'U') { continue; }
         cout<<"["<<i<<"] ";
         i++;
-        if ((*iter)->_TYPE == 'C') { cout<<"CONST0"<<endl; continue; }
-        cout<<left<<setw(4)<<(*iter)->getTypeStr()<<internal<<(*iter)->_ID;
-        if ((*iter)->_fanin1.first) {
+        if (_gateType[id] == 'C') { cout<<"CONST0"<<endl; continue; }
+        cout<<left<<setw(4)<<_gateList[id]->getTypeStr()<<internal<<id;
+        for (int j = 0; j < 2; j++) {
+            CirLit lit = _faninLit[2*id+j];
+            if (lit == CIR_NO_LIT) { continue; }
             cout<<" ";
-            if ((*iter)->_fanin1.first->_TYPE == 'U') { cout<<"*"; }
-            if ((*iter)->_fanin1.second) { cout<<"!"; }
-            cout<<(*iter)->_fanin1.first->_ID; }
-
-        if ((*iter)->_fanin2.first) {
-            cout<<" ";
-            if ((*iter)->_fanin2.first->_TYPE == 'U') { cout<<"*"; }
-            if ((*iter)->_fanin2.second) { cout<<"!"; }
-            cout<<(*iter)->_fanin2.first->_ID; }
-        if ((*iter)->_NAME != "")
-            cout<<" ("<<(*iter)->_NAME<<")";
+            if (_gateType[lit/2] == 'U') { cout<<"*"; }
+            if (lit%2) { cout<<"!"; }
+            cout<<lit/2; }
+        const CirSymbol* sym = (id > M) ? &_poSymbol[id - M - 1] : piSym[id];
+        if (sym && sym->len) {
+            cout<<" (";
+            cout.write(_symbolArena.data() + sym->pos, sym->len)<<")"; }
         cout<<endl;
     }
 }
@@ -513,15 +863,29 @@ CirMgr::printFloatGates() const
 void
 CirMgr::printFECPairs()
 {
-    int num = 0;
-    for (auto iter : _fecList) {
-        cout<<"["<<num<<"]";
-        for (auto it : iter.second) {
+    for (int c = 0; c < numFEC(); c++) {
+        cout<<"["<<c<<"]";
+        int rep = _fecMember[_fecStart[c]];
+        for (int i = _fecStart[c]; i < _fecStart[c+1]; i++) {
             cout<<" ";
-            if (it.second.second) { cout<<"!"; }
-            cout<<it.second.first->_ID; }
-        cout<<endl;
-        num++; }
+            if (simValue(_fecMember[i]) != simValue(rep)) { cout<<"!"; }
+            cout<<_fecMember[i]; }
+        cout<<endl; }
+}
+
+// Other members of the FEC class of gate "id", '!' if inverted to it
+void
+CirMgr::printGateFECs(int id) const
+{
+    int c = _fecClass[id];
+    if (c < 0 || c >= numFEC()) { return; }
+    auto b = _fecMember.begin() + _fecStart[c], e = _fecMember.begin() + _fecStart[c+1];
+    if (!binary_search(b, e, id)) { return; } // _fecClass older than the classes
+    for (int i = _fecStart[c]; i < _fecStart[c+1]; i++) {
+        if (_fecMember[i] == id) { continue; }
+        cout<<" ";
+        if (simValue(_fecMember[i]) != simValue(id)) { cout<<"!"; }
+        cout<<_fecMember[i]; }
 }
 
 void
@@ -529,29 +893,63 @@ CirMgr::writeAag(ostream& outfile) const
 {
     int newA = 0;
     outfile<<"aag "<<M<<" "<<I<<" "<<L<<" "<<O<<" ";
-    for (auto iter = _dfsList.begin(); iter != _dfsList.end(); iter++) {
-        if ((*iter)->_TYPE == 'A')
+    for (auto id : _dfsList) {
+        if (_gateType[id] == 'A')
             newA++;
     }
     outfile<<newA<<endl;
     for (auto iter = _piList.begin(); iter != _piList.end(); iter++)
-        outfile<<(*iter)->_INDEX<<endl;
+        outfile<<(*iter)->_ID*2<<endl;
     for (auto iter = _poList.begin(); iter != _poList.end(); iter++)
-        outfile<<(*iter)->_INDEX<<endl;
-    for (auto iter = _dfsList.begin(); iter != _dfsList.end(); iter++) {
-        if ((*iter)->_TYPE == 'A')
-            outfile<<(*iter)->_INDEX<<" "<<(*iter)->_fanin1.first->_INDEX + (*iter)->_fanin1.second<<" "
-                                         <<(*iter)->_fanin2.first->_INDEX + (*iter)->_fanin2.second<<endl;
+        outfile<<_faninLit[2*(*iter)->_ID]<<endl;
+    for (auto id : _dfsList) {
+        if (_gateType[id] == 'A')
+            outfile<<id*2<<" "<<_faninLit[2*id]<<" "<<_faninLit[2*id+1]<<endl;
     }
+    writeSymbol(outfile);
+}
+
+// Binary AIGER needs PIs 1..I and AIGs I+1.. in topological order, so the
+// AIGs in _dfsList are renumbered; UNDEF gates become CONST 0
+void
+CirMgr::writeAig(ostream& outfile) const
+{
+    vector<CirLit> newLit(_gateList.size(), 0);
+    unsigned next = 1;
+    for (auto gate : _piList) { newLit[gate->_ID] = 2 * next++; }
+    for (auto id : _dfsList) {
+        if (_gateType[id] == 'A') { newLit[id] = 2 * next++; } }
+    auto lit = [&](CirLit l) { return newLit[l/2] ^ (l & 1); };
+
+    outfile<<"aig "<<next-1<<" "<<I<<" "<<L<<" "<<O<<" "<<next-1-I<<endl;
+    for (auto iter = _poList.begin(); iter != _poList.end(); iter++)
+        outfile<<lit(_faninLit[2*(*iter)->_ID])<<endl;
+    for (auto id : _dfsList) {
+        if (_gateType[id] != 'A') { continue; }
+        CirLit in0 = lit(_faninLit[2*id]), in1 = lit(_faninLit[2*id+1]);
+        if (in0 < in1) { swap(in0, in1); }
+        encodeNum(outfile, newLit[id] - in0);
+        encodeNum(outfile, in0 - in1);
+    }
+    writeSymbol(outfile);
+}
+
+void
+CirMgr::writeSymbol(ostream& outfile) const
+{
+    // Names are written straight from the arena
+    const char* arena = _symbolArena.data();
     int i = 0, j = 0;
-    for (auto iter = _piList.begin(); iter != _piList.end(); iter++) {
-        if ((*iter)->_NAME != "") {
-            outfile<<"i"<<i<<" "<<(*iter)->_NAME<<endl;
+    for (auto& sym : _piSymbol) {
+        if (sym.len) {
+            outfile<<"i"<<i<<" ";
+            outfile.write(arena + sym.pos, sym.len)<<'\n';
             i++; }
     }
-    for (auto iter = _poList.begin(); iter != _poList.end(); iter++) {
-        if ((*iter)->_NAME != "") {
-            outfile<<"o"<<j<<" "<<(*iter)->_NAME<<endl;
+    for (auto& sym : _poSymbol) {
+        if (sym.len) {
+            outfile<<"o"<<j<<" ";
+            outfile.write(arena + sym.pos, sym.len)<<'\n';
             j++; }
     }
     outfile<<"c"<<endl;
@@ -10,13 +10,16 @@
 #define CIR_MGR_H
 
 #include <map>
-#include <deque>
 #include <set>
 #include <vector>
 #include <string>
 #include <utility>
 #include <fstream>
 #include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 using namespace std;
 
@@ -29,42 +32,77 @@ class CirMgr
 {
 public:
    CirMgr() : fraiged(false), simed(false) {}
-   ~CirMgr() { for (auto iter = _gateList.begin(); iter != _gateList.end(); iter++) { delete iter->second; } }
+   ~CirMgr() { stopSimWorkers(); }
 
    // Access functions: return '0' if "gid" corresponds to an undefined gate.
     CirGate* getGate(int);
+    CirGate* newGate(int ID, int LINE, char TYPE);
+    void removeGate(int ID);
+
+    // Packed AIG access: fanin "i" (0/1) of gate "id" as literal ID*2+inv
+    char gateType(int id) const { return _gateType[id]; }
+    CirLit faninLit(int id, int i) const { return _faninLit[2*id+i]; }
+    CirGate* litGate(CirLit lit) { return &_gateArena[lit >> 1]; }
+    size_t simValue(int id) const { return _simValue[id * _simWords]; }
+    string symbolName(int id) const;
 
     // Member functions about circuit construction
-    bool readCircuit(const string&);
-    bool readHeader(const string&);
-    bool readInput(const string&);
-    bool readOutput(const string&, int&);
-    bool readAig(const string&);
-    bool readComment(const string&, bool&);
-    bool readSymbol(const string&);
-    void splitString (const string&, vector<string>&) const;
-    void connectCircuit();
-    void dfsTraversal(CirGate*);
+    bool readCircuit(const string&, int threads = 1, bool simplify = false);
+    bool readHeader(const char*, unsigned);
+    bool readInput(const char*, unsigned);
+    bool readOutput(const char*, unsigned, int&);
+    bool readAig(const char*, unsigned);
+    bool readAigLines(const char*&, const char*, int&, int threads);
+    bool readBinaryAig(const char*&, const char*);
+    bool readComment(const char*, unsigned, bool&);
+    bool readSymbol(const char*, unsigned);
+    void connectCircuit(int threads = 1);
+    void dfsTraversal();
+    void updateDfsList();
+    void dfsFrom(int first);
 
     // Member functions about circuit optimization
     void sweep();
     void optimize();
+    void mergeGate(CirGate* from, CirLit to);
+    void simplifyAigs();
 
     // Member functions about simulation
-    void randomSim();
+    void randomSim(size_t maxPatterns = 0, int maxSeconds = 0, bool guided = false);
+    void largestClassSupport(vector<char>& support) const;
     void fileSim(ifstream&);
-    void setSimLog(ofstream *logFile) { _simLog = logFile; }
-    int  Simulate(bool random, vector<string>& pi, int num = 64);
+    void setSimLog(ofstream *logFile, bool binary = false);
+    void writeSimLog(int num);
+    void setSimWords(int);
+    void setSimThreads(int);
+    void buildLevels();
+    void printLevelTime() const;
+    void simulateLevels(int words);
+    void simulateLevelShare(int t, int words);
+    void simWorker(int t, int seen);
+    void stopSimWorkers();
+    void setPIWord(const vector<size_t>& tile, int w);
+    int  Simulate(int num = 64);
+    int  refineFEC(int words);
+    void resetSimCone() { _simCone.clear(); _coneMembers = -1; }
+    const vector<int>& simOrder();
+    void syncSimValues();
+    int  numFEC() const { return (int)_fecStart.size() - 1; }
     void add_first_FEC();
     void store_FEC();
 
     // Member functions about fraig
     void strash();
-    size_t StrashKey(CirGate* g) const;
-    void fraig();
+    int  strashFind(CirLit a, CirLit b) const;
+    void strashInsert(int id, bool replace);
+    void strashErase(int id);
+    void fraig(int threads = 0);
+    void fraigParallel(int threads);
+    void finishFraig();
     void genProofModel(SatSolver& s);
+    void loadCone(SatSolver& s, int id);
     bool proof(SatSolver& s, CirGate* first, CirGate* second);
-    int satUpdate(vector<string>& input, int num = 64);
+    int satUpdate(const vector<size_t>& piWords);
     void mergeResult();
 
     // Member functions about circuit reporting
@@ -74,25 +112,86 @@ public:
     void printPOs() const;
     void printFloatGates() const;
     void printFECPairs();
+    void printGateFECs(int id) const;
     void writeAag(ostream&) const;
+    void writeAig(ostream&) const;
+    void writeSymbol(ostream&) const;
     void writeGate(ostream&, CirGate*) const;
 
 
 private:
-    ofstream *_simLog;
+    ofstream *_simLog = 0;
+    bool _simLogBinary = false;  // packed words instead of 0/1 text
+    vector<char> _simLogBuf;     // text of one logged block
 
     bool fraiged;
     bool simed;
     int M,I,L,O,A;
     vector<CirGate*> _piList;
     vector<CirGate*> _poList;
-    vector<pair<CirGate*,vector<int>>> _aigList;
-    map<int,CirGate*> _gateList;
-    vector<CirGate*> _dfsList;
+    string _symbolArena;         // all PI/PO names back to back
+    vector<CirSymbol> _piSymbol; // PI k -> its name in _symbolArena
+    vector<CirSymbol> _poSymbol; // PO k -> its name in _symbolArena
+    CirFanoutPool _fanoutPool;   // fanout arrays beyond the inline ones
+    vector<CirGate> _gateArena;  // gate storage indexed by ID, size M+O+1
+    vector<CirGate*> _gateList;  // ID -> gate in _gateArena, 0 if not defined
+    vector<int> _dfsList;        // gate IDs in topological order
+    vector<int> _dfsPos;         // gate ID -> index in _dfsList, if visited
+    vector<int> _poDfsStart;     // PO k -> _dfsList index its traversal began at
+    int _dfsDirty = -1;          // first _dfsList index mergeGate() changed, -1 if none
+
+    // Packed AIG core (structure of arrays), indexed by gate ID
+    vector<char> _gateType;      // 'C', 'U', 'A', 'I', 'O', or 0 if not defined
+    vector<CirLit> _faninLit;    // 2 literals per gate, CIR_NO_LIT if unused
+    vector<unsigned> _visitStamp; // _travId if reached by the last DFS
+    unsigned _travId = 0;
+    int _simWords = 1;           // 64-bit simulation words per gate
+    vector<size_t> _simValue;    // _simWords words per gate
+
+    // Levelized order for multi-threaded simulation
+    int _simThreads = 1;
+    vector<int> _levelList;      // AIGs and POs sorted by level
+    vector<int> _levelStart;     // level L is [_levelStart[L-1], _levelStart[L])
+    vector<double> _levelTime;   // accumulated seconds per level
+    // Persistent workers 1.._simThreads-1 of simulateLevels(); a round starts
+    // when _simRound is bumped, levels are separated by a barrier
+    vector<thread> _simWorkers;
+    mutex _simLock;
+    condition_variable _simWake;
+    int _simRound = 0;
+    int _simRoundWords = 1;
+    bool _simQuit = false;
+    atomic<int> _simArrived{0}, _simPhase{0};
+
+    // Fanin cone of the FEC members, the only gates simulated once few are left
+    vector<int> _simCone;        // AIG IDs in topological order
+    int _coneMembers = -1;       // FEC members when _simCone was built, -1 if none
+    bool _coneStale = false;     // gates outside _simCone hold old values
+    int _lastWords = 1;          // words of the last simulation
     set<int> _floatList;
     set<int> _notusedList;
-    deque<pair<int,map<int, pair<CirGate*, bool>>>> _fecList;
+
+    // FEC classes stored back to back: class c is _fecMember[_fecStart[c]] ..
+    // _fecMember[_fecStart[c+1]-1], members and classes sorted by gate ID
+    vector<int> _fecMember;
+    vector<int> _fecStart = vector<int>(1, 0);
+    vector<int> _fecClass;       // gate ID -> FEC class as of store_FEC(), -1 if none
+    // Scratch of refineFEC(), kept between rounds so refinement does not allocate
+    vector<int> _fecNewMember;
+    vector<int> _fecNewStart;
+    vector<int> _fecSub;         // sub-class of each member of the class being split
+    vector<int> _fecSubRep;      // first member of each sub-class
+    vector<int> _fecSubPos;      // size, then output position of each sub-class
+    vector<pair<int,int>> _fecOrder;
+    vector<unsigned> _fecTableStamp; // open-addressing table over signatures,
+    vector<int> _fecTableSub;        // slot is live if its stamp is _fecStamp
+    unsigned _fecStamp = 0;
     vector<pair<CirGate*,pair<CirGate*,bool>>> _mergeList;
+
+    // Structural hash of the AIGs, open addressing over the exact fanin pair
+    vector<unsigned long long> _strashKey;
+    vector<int> _strashGate;     // AIG of the slot, -1 if empty
+    size_t _strashCount = 0;
 };
 
 #endif // CIR_MGR_H
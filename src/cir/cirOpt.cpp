@@ -23,6 +23,19 @@ using namespace std;
 /**************************************/
 /*   Static varaibles and functions   */
 /**************************************/
+// Constant-fanin and same-fanin rules for AND(in1, in2): true with the
+// literal "to" replacing the gate if one applies
+static bool
+simplifyAnd(CirLit in1, CirLit in2, CirLit& to)
+{
+    if (in1/2 == in2/2) {
+        if (in1/2 == 0) { to = (in1 & in2 & 1) ? in2 : 0; } // !0 !0 -> !0; 0 0 / 0 !0 / !0 0 -> 0
+        else { to = (in1 != in2) ? 0 : in1; } } // ? !? / !? ? -> 0; ? ? / !? !? -> ?
+    else if (in1/2 == 0) { to = (in1 & 1) ? in2 : 0; } // !0 ? -> ?; 0 ? -> 0
+    else if (in2/2 == 0) { to = (in2 & 1) ? in1 : 0; } // ? !0 -> ?; ? 0 -> 0
+    else { return false; }
+    return true;
+}
 
 /**************************************************/
 /*   Public member functions about optimization   */
@@ -33,31 +46,29 @@ using namespace std;
 void
 CirMgr::sweep()
 {
-    for (auto iter = _gateList.begin(); iter != _gateList.end(); ) {
-        if (!iter->second->_visited) {
-            if (iter->second->_TYPE == 'A') {
-                A--;
-                #ifndef noprint
-                cout<<"Sweeping: AIG("<<iter->first<<") removed..."<<endl;
-                #endif
-                iter->second->_fanin1.first->_fanoutList.erase(iter->first);
-                iter->second->_fanin2.first->_fanoutList.erase(iter->first);
-                if (iter->second->_fanin1.first->_TYPE == 'I' && iter->second->_fanin1.first->_fanoutList.empty())
-                    _notusedList.insert(iter->second->_fanin1.first->_ID);
-                if (iter->second->_fanin2.first->_TYPE == 'I' && iter->second->_fanin2.first->_fanoutList.empty())
-                    _notusedList.insert(iter->second->_fanin2.first->_ID);
-                _floatList.erase(iter->first);
-                _notusedList.erase(iter->first);
-                iter = _gateList.erase(iter);
-                continue; }
-            else if (iter->second->_TYPE == 'U') {
-                #ifndef noprint
-                cout<<"Sweeping: UNDEF("<<iter->first<<") removed..."<<endl;
-                #endif
-                iter = _gateList.erase(iter);
-                continue; }
-        }
-        iter++;
+    for (int id = 0, n = _gateList.size(); id < n; id++) {
+        if (!_gateList[id] || _visitStamp[id] == _travId) { continue; }
+        if (_gateType[id] == 'A') {
+            A--;
+            #ifndef noprint
+            cout<<"Sweeping: AIG("<<id<<") removed..."<<endl;
+            #endif
+            CirGate* in1 = litGate(_faninLit[2*id]);
+            CirGate* in2 = litGate(_faninLit[2*id+1]);
+            in1->_fanoutList.erase(id);
+            in2->_fanoutList.erase(id);
+            if (_gateType[in1->_ID] == 'I' && in1->_fanoutList.empty())
+                _notusedList.insert(in1->_ID);
+            if (_gateType[in2->_ID] == 'I' && in2->_fanoutList.empty())
+                _notusedList.insert(in2->_ID);
+            _floatList.erase(id);
+            _notusedList.erase(id);
+            removeGate(id); }
+        else if (_gateType[id] == 'U') {
+            #ifndef noprint
+            cout<<"Sweeping: UNDEF("<<id<<") removed..."<<endl;
+            #endif
+            removeGate(id); }
     }
 }
 
@@ -67,112 +78,96 @@ CirMgr::sweep()
 void
 CirMgr::optimize()
 {
-    char TO_DO = ' ';
     int original_A = A;
-    for (auto iter = _dfsList.begin(); iter != _dfsList.end(); iter++)
+    for (auto id : _dfsList)
     {
-        if ((*iter)->_TYPE == 'A')
-        {
-            if ((*iter)->_fanin1.first->_ID == (*iter)->_fanin2.first->_ID) {
-                if ((*iter)->_fanin1.first->_ID == 0) { // 0 0 / 0 !0 / !0 0 / !0 !0
-                    if ((*iter)->_fanin1.second && (*iter)->_fanin2.second) { TO_DO = '?'; } // !0 !0
-                    else { TO_DO = '0'; } } // 0 0 / 0 !0 / !0 0
-                else { // ? ? / ? !? / !? ? / !? !?
-                    if ((*iter)->_fanin1.second != (*iter)->_fanin2.second) { TO_DO = '0'; } // ? !? / !? ?
-                    else { TO_DO = '?'; } } } // ? ? / !? !?
-            else if ((*iter)->_fanin1.first->_ID == 0) { // 0 ? / !0 ?
-                if ((*iter)->_fanin1.second) { TO_DO = '?'; } // !0 ? / !0 !?
-                else { TO_DO = '0'; } } // 0 ?
-            else if ((*iter)->_fanin2.first->_ID == 0) {
-                if ((*iter)->_fanin2.second) { TO_DO = '?'; } // ? !0 / !? !0
-                else { TO_DO = '0'; } } // ? 0
-            else { TO_DO = ' '; }
+        if (_gateType[id] != 'A') { continue; }
+        CirLit to;  // literal replacing this gate
+        if (!simplifyAnd(_faninLit[2*id], _faninLit[2*id+1], to)) { continue; }
 
-            switch (TO_DO) {
-                case ' ': continue;
-                case '0': {
-                    (*iter)->_fanin1.first->_fanoutList.erase((*iter)->_ID);
-                    (*iter)->_fanin2.first->_fanoutList.erase((*iter)->_ID);
-                    for (auto it = (*iter)->_fanoutList.begin(); it != (*iter)->_fanoutList.end(); it++) {
-                        if (it->second.first->_fanin1.first->_ID == (*iter)->_ID) {
-                            it->second.first->_fanin1.first = _gateList[0];
-                            if (it->second.first->_TYPE == 'O') { it->second.first->_INDEX = 0 + it->second.first->_fanin1.second; }
-                        }
-                        if (it->second.first->_fanin2.first && it->second.first->_fanin2.first->_ID == (*iter)->_ID)
-                            it->second.first->_fanin2.first = _gateList[0];
-                        _gateList[0]->_fanoutList.insert(*it);
-                    }
-                    #ifndef noprint
-                    cout<<"Simplifying: 0 merging "<<(*iter)->_ID<<"..."<<endl;
-                    #endif
-                    A--;
-                    _gateList.erase((*iter)->_ID);
-                    delete *iter; *iter = 0;
-                    break; }
-                case '?': {
-                    (*iter)->_fanin1.first->_fanoutList.erase((*iter)->_ID);
-                    (*iter)->_fanin2.first->_fanoutList.erase((*iter)->_ID);
-                    for (auto it = (*iter)->_fanoutList.begin(); it != (*iter)->_fanoutList.end(); it++) {
-                        if ((*iter)->_fanin1.first->_ID != 0) { // ? ? / !? !? / ? !0 / !? !0
-                            if (it->second.first->_fanin1.first->_ID == (*iter)->_ID) {
-                                it->second.first->_fanin1.first = (*iter)->_fanin1.first;
-                                it->second.first->_fanin1.second ^= (*iter)->_fanin1.second;
-                                it->second.second = it->second.first->_fanin1.second;
-                                if (it->second.first->_TYPE == 'O') {
-                                    it->second.first->_INDEX = (*iter)->_fanin1.first->_ID * 2 + it->second.first->_fanin1.second; }
-                            }
-                            if (it->second.first->_fanin2.first && it->second.first->_fanin2.first->_ID == (*iter)->_ID) {
-                                it->second.first->_fanin2.first = (*iter)->_fanin1.first;
-                                it->second.first->_fanin2.second ^= (*iter)->_fanin1.second;
-                                it->second.second = it->second.first->_fanin2.second;
-                            }
-
-                            (*iter)->_fanin1.first->_fanoutList.insert(*it);
-                        }
-                        else { // !0 !0 / !0 ? / !0 !?
-                            if (it->second.first->_fanin1.first->_ID == (*iter)->_ID) {
-                                it->second.first->_fanin1.first = (*iter)->_fanin2.first;
-                                it->second.first->_fanin1.second ^= (*iter)->_fanin2.second;
-                                it->second.second = it->second.first->_fanin1.second;
-                                if (it->second.first->_TYPE == 'O') {
-                                    it->second.first->_INDEX = (*iter)->_fanin2.first->_ID * 2 + it->second.first->_fanin1.second; }
-                            }
-                            if (it->second.first->_fanin2.first && it->second.first->_fanin2.first->_ID == (*iter)->_ID) {
-                                it->second.first->_fanin2.first = (*iter)->_fanin2.first;
-                                it->second.first->_fanin2.second ^= (*iter)->_fanin2.second;
-                                it->second.second = it->second.first->_fanin2.second;
-                            }
-                            (*iter)->_fanin2.first->_fanoutList.insert(*it);
-                        }
-                    }
-                    #ifndef noprint
-                    if ((*iter)->_fanin1.first->_ID != 0) {
-                        cout<<"Simplifying: "<<(*iter)->_fanin1.first->_ID<<" merging ";
-                        if ((*iter)->_fanin1.second) { cout<<"!"; }
-                        cout<<(*iter)->_ID<<"..."<<endl; }
-                    else {
-                        cout<<"Simplifying: "<<(*iter)->_fanin2.first->_ID<<" merging ";
-                        if ((*iter)->_fanin2.second) { cout<<"!"; }
-                        cout<<(*iter)->_ID<<"..."<<endl; }
-                    #endif
-                    A--;
-                    _gateList.erase((*iter)->_ID);
-                    delete *iter; *iter = 0;
-                    break; }
-            }
-        }
+        #ifndef noprint
+        cout<<"Simplifying: "<<to/2<<" merging ";
+        if (to & 1) { cout<<"!"; }
+        cout<<id<<"..."<<endl;
+        #endif
+        mergeGate(_gateList[id], to);
+        A--;
     }
     if (A != original_A) {
-        _dfsList.clear();
-        for (auto iter = _gateList.begin(); iter != _gateList.end(); iter++) { iter->second->_visited = false; }
-        for (auto iter = _poList.begin(); iter != _poList.end(); iter++) { dfsTraversal(*iter); }
+        updateDfsList();
     }
-    for (auto iter = _gateList.begin(); iter != _gateList.end(); iter++) {
-        if (iter->second->_TYPE != 'O' && iter->second->_TYPE != 'C' && iter->second->_fanoutList.empty())
-            _notusedList.insert(iter->second->_ID);
+    for (auto gate : _gateList) {
+        if (gate && _gateType[gate->_ID] != 'O' && _gateType[gate->_ID] != 'C' && gate->_fanoutList.empty())
+            _notusedList.insert(gate->_ID);
     }
 }
 
 /***************************************************/
 /*   Private member functions about optimization   */
 /***************************************************/
+// Simplify and strash the AIGs as read, before connectCircuit(): fanins
+// first, each AIG takes the literals its fanins were replaced by, then is
+// itself replaced if simplifyAnd() applies or the strash table holds an AIG
+// with the same fanins. Replaced AIGs are never connected.
+void
+CirMgr::simplifyAigs()
+{
+    vector<CirLit> repl(M+1);
+    vector<char> state(M+1, 0); // 1: on the stack, 2: done
+    for (int id = 0; id <= M; id++) { repl[id] = id * 2; }
+    auto resolve = [&](CirLit lit) { return lit/2 <= (CirLit)M ? repl[lit/2] ^ (lit & 1) : lit; };
+
+    vector<pair<int,int>> stack;
+    auto visit = [&](int root) {
+        if (_gateType[root] != 'A' || state[root]) { return; }
+        stack.push_back({root, 0});
+        state[root] = 1;
+        while (!stack.empty()) {
+            pair<int,int>& top = stack.back();
+            if (top.second < 2) {
+                int g = _faninLit[2*top.first + top.second++] / 2;
+                if (_gateType[g] == 'A' && !state[g]) { state[g] = 1; stack.push_back({g, 0}); }
+                continue; }
+            const int id = top.first;
+            stack.pop_back();
+            state[id] = 2;
+            CirLit in1 = _faninLit[2*id] = resolve(_faninLit[2*id]);
+            CirLit in2 = _faninLit[2*id+1] = resolve(_faninLit[2*id+1]);
+            CirLit to;
+            int n;
+            if (simplifyAnd(in1, in2, to)) { repl[id] = to; }
+            else if ((n = strashFind(in1, in2)) >= 0) { repl[id] = n * 2; }
+            else { strashInsert(id, false); continue; }
+            _gateList[id] = 0;
+            _gateType[id] = 0;
+            A--;
+        }
+    };
+    for (auto gate : _poList) { visit(_faninLit[2*gate->_ID] / 2); }
+    for (int id = 1; id <= M; id++) { visit(id); }
+    for (auto gate : _poList) { _faninLit[2*gate->_ID] = resolve(_faninLit[2*gate->_ID]); }
+}
+
+// Redirect every fanout of AIG "from" to literal "to", then remove "from".
+// The first fanout in _dfsList marks where updateDfsList() has to resume.
+void
+CirMgr::mergeGate(CirGate* from, CirLit to)
+{
+    int id = from->_ID;
+    litGate(_faninLit[2*id])->_fanoutList.erase(id);
+    litGate(_faninLit[2*id+1])->_fanoutList.erase(id);
+    for (CirLit f : from->_fanoutList) {
+        const int out = f/2;
+        if (_visitStamp[out] == _travId && (_dfsDirty < 0 || _dfsPos[out] < _dfsDirty))
+            _dfsDirty = _dfsPos[out];
+        const bool aig = (_gateType[out] == 'A');
+        if (aig) { strashErase(out); }
+        for (int i = 0; i < 2; i++) {
+            CirLit& lit = _faninLit[2*out+i];
+            if (lit != CIR_NO_LIT && lit/2 == (CirLit)id) { lit = to ^ (lit & 1); }
+        }
+        if (aig) { strashInsert(out, false); }
+    }
+    litGate(to)->_fanoutList.merge(from->_fanoutList, to & 1, _fanoutPool);
+    removeGate(id);
+}
@@ -11,12 +11,21 @@
 #include <iomanip>
 #include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <cstring>
+#include <cstdint>
 #include "cirMgr.h"
 #include "cirGate.h"
 #include "util.h"
-#include <unordered_map>
 #include <bitset>
 #include <deque>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CIR_SIM_X86
+#endif
 
 using namespace std;
 
@@ -27,202 +36,719 @@ using namespace std;
 /**************************************/
 /*   Static varaibles and functions   */
 /**************************************/
-struct SimKey
+// Hash of the signature v[0..words) complemented by "mask"
+static inline size_t
+simHash(const size_t* v, size_t mask, int words)
 {
-    SimKey(CirGate* g, bool i) {
-        if (i) { _value = ~(g->getValue()); }
-        else { _value = g->getValue(); } }
-    size_t _value;
-    bool operator == (const SimKey& k) const { return _value == k._value; }
-};
+    size_t h = 0;
+    for (int w = 0; w < words; w++) { h = h * 1000003 ^ (v[w] ^ mask); }
+    return h;
+}
+
+// AND kernel over simulation words: out[w] = (a[w] ^ ma) & (b[w] ^ mb),
+// where ma/mb are all-0 or all-1 masks for the fanin inversions.
+typedef void (*SimAndFunc)(size_t*, const size_t*, size_t, const size_t*, size_t, int);
 
+static void
+simAndScalar(size_t* out, const size_t* a, size_t ma, const size_t* b, size_t mb, int words)
+{
+    for (int w = 0; w < words; w++) { out[w] = (a[w] ^ ma) & (b[w] ^ mb); }
+}
 
-namespace std {
-    template <> struct hash<SimKey>
-    { size_t operator()(const SimKey& k) const { return (k._value); } };
+#ifdef CIR_SIM_X86
+__attribute__((target("avx2"))) static void
+simAndAvx2(size_t* out, const size_t* a, size_t ma, const size_t* b, size_t mb, int words)
+{
+    const __m256i va = _mm256_set1_epi64x((long long)ma);
+    const __m256i vb = _mm256_set1_epi64x((long long)mb);
+    int w = 0;
+    for (; w + 4 <= words; w += 4) {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a + w)), va);
+        __m256i y = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(b + w)), vb);
+        _mm256_storeu_si256((__m256i*)(out + w), _mm256_and_si256(x, y)); }
+    for (; w < words; w++) { out[w] = (a[w] ^ ma) & (b[w] ^ mb); }
+}
+
+__attribute__((target("avx512f"))) static void
+simAndAvx512(size_t* out, const size_t* a, size_t ma, const size_t* b, size_t mb, int words)
+{
+    const __m512i va = _mm512_set1_epi64((long long)ma);
+    const __m512i vb = _mm512_set1_epi64((long long)mb);
+    int w = 0;
+    for (; w + 8 <= words; w += 8) {
+        __m512i x = _mm512_xor_si512(_mm512_loadu_si512((const void*)(a + w)), va);
+        __m512i y = _mm512_xor_si512(_mm512_loadu_si512((const void*)(b + w)), vb);
+        _mm512_storeu_si512((void*)(out + w), _mm512_and_si512(x, y)); }
+    for (; w < words; w++) { out[w] = (a[w] ^ ma) & (b[w] ^ mb); }
+}
+#endif
+
+// Pick the widest kernel the running CPU supports
+static SimAndFunc
+selectSimAnd()
+{
+    #ifdef CIR_SIM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) { return simAndAvx512; }
+    if (__builtin_cpu_supports("avx2"))    { return simAndAvx2; }
+    #endif
+    return simAndScalar;
+}
+
+static const SimAndFunc simAnd = selectSimAnd();
+
+// Evaluate AIG or PO gate "id" over "words" words of its block
+static inline void
+simGate(int id, char type, const CirLit* lit, size_t* value, size_t stride, int words, SimAndFunc kernel)
+{
+    if (type == 'A') {
+        const size_t* in1 = value + lit[2*id]/2 * stride;
+        const size_t* in2 = value + lit[2*id+1]/2 * stride;
+        size_t inv1 = -size_t(lit[2*id] & 1);
+        size_t inv2 = -size_t(lit[2*id+1] & 1);
+        if (words == 1) { value[id * stride] = (in1[0] ^ inv1) & (in2[0] ^ inv2); }
+        else { kernel(value + id * stride, in1, inv1, in2, inv2, words); } }
+    else if (type == 'O') { // (in ^ inv) & (in ^ inv) is a buffer
+        const size_t* in1 = value + lit[2*id]/2 * stride;
+        size_t inv1 = -size_t(lit[2*id] & 1);
+        kernel(value + id * stride, in1, inv1, in1, inv1, words); }
 }
 
+// In-place transpose of a 64x64 bit matrix: bit k of a[j] becomes bit j of a[k]
+static void
+transpose64(size_t a[64])
+{
+    size_t m = 0x00000000FFFFFFFFULL;
+    for (int j = 32; j != 0; j >>= 1, m ^= m << j)
+        for (int k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+            size_t t = ((a[k] >> j) ^ a[k | j]) & m;
+            a[k | j] ^= t;
+            a[k] ^= t << j; }
+}
+
+// Pack the 0/1 characters str[0..len) into bits of row[], character j to
+// bit j; false if any other character is found
+static bool
+packPatternRow(const char* str, size_t len, size_t* row)
+{
+    size_t j = 0;
+    for (size_t w = 0; w < (len + 63) / 64; w++) { row[w] = 0; }
+    #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (; j + 8 <= len; j += 8) { // 8 characters at a time
+        size_t x;
+        memcpy(&x, str + j, 8);
+        if ((x ^ 0x3030303030303030ULL) & 0xFEFEFEFEFEFEFEFEULL) { return false; }
+        row[j/64] |= ((x & 0x0101010101010101ULL) * 0x0102040810204080ULL >> 56) << (j%64); }
+    #endif
+    for (; j < len; j++) {
+        if (str[j] != '0' && str[j] != '1') { return false; }
+        row[j/64] |= size_t(str[j] - '0') << (j%64); }
+    return true;
+}
+
+// Bits 0..n-1 of "bits" as '0'/'1' characters out[0..n), n <= 64
+static inline void
+bitsToChars(size_t bits, char* out, int n)
+{
+    int i = 0;
+    #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (; i + 8 <= n; i += 8) { // byte b -> 8 characters, bit j to byte j
+        size_t x = (bits >> i & 0xFF) * 0x0101010101010101ULL & 0x8040201008040201ULL;
+        x = ((x + 0x7F7F7F7F7F7F7F7FULL) >> 7 & 0x0101010101010101ULL) | 0x3030303030303030ULL;
+        memcpy(out + i, &x, 8); }
+    #endif
+    for (; i < n; i++) { out[i] = '0' + (bits >> i & 1); }
+}
+
+// Characters of "gates" for the first "num" patterns: gate j of pattern k
+// goes to buf[k * lineLen + j]. Each 64x64 tile of words is transposed so
+// that a pattern's 64 gates are one word.
+static void
+writeBitColumns(const vector<CirGate*>& gates, const size_t* value, size_t stride,
+                int num, char* buf, size_t lineLen)
+{
+    const int n = gates.size();
+    size_t a[64];
+    for (int w = 0; w < (num + 63) / 64; w++) {
+        const int rows = std::min(64, num - 64*w);
+        for (int t = 0; 64*t < n; t++) {
+            const int cols = std::min(64, n - 64*t);
+            for (int j = 0; j < 64; j++)
+                a[j] = j < cols ? value[gates[64*t + j]->getID() * stride + w] : 0;
+            transpose64(a);
+            for (int k = 0; k < rows; k++)
+                bitsToChars(a[k], buf + (64*w + k) * lineLen + 64*t, cols); }
+    }
+}
+
+// Whitespace separated words of a pattern file, read in large chunks
+class CirPatternReader
+{
+public:
+    CirPatternReader(istream& in) : _in(in), _buf(1 << 20), _pos(0), _end(0) {}
+
+    // Next word, valid until the next call; false at the end of the file
+    bool next(const char*& word, size_t& len) {
+        while (true) {
+            while (_pos < _end && isspace((unsigned char)_buf[_pos])) { _pos++; }
+            if (_pos < _end || !refill()) { break; } }
+        if (_pos == _end) { return false; }
+        size_t e = _pos;
+        while (true) {
+            while (e < _end && !isspace((unsigned char)_buf[e])) { e++; }
+            if (e < _end) { break; }
+            e -= _pos;                     // the word runs into the next chunk
+            if (!refill()) { e += _pos; break; }
+            e += _pos; }
+        word = &_buf[_pos];
+        len = e - _pos;
+        _pos = e;
+        return true;
+    }
+
+private:
+    // Keep _buf[_pos.._end), moved to the front, and append the next chunk
+    bool refill() {
+        if (!_in) { return false; }
+        _end -= _pos;
+        memmove(&_buf[0], &_buf[_pos], _end);
+        _pos = 0;
+        if (_end * 2 > _buf.size()) { _buf.resize(_buf.size() * 2); }
+        _in.read(&_buf[_end], _buf.size() - _end);
+        _end += _in.gcount();
+        return _in.gcount() > 0;
+    }
+
+    istream& _in;
+    vector<char> _buf;
+    size_t _pos, _end;
+};
+
 void
 CirMgr::add_first_FEC()
 {
-    if (_fecList.empty() && !fraiged) { // Put All aig gates in one FEC group and add to _fecList (if fraiged, don't put again)
-        map<int, pair<CirGate*,bool>> fecGroup;
-        fecGroup.insert({0, {_gateList[0],false}});
-        for (auto gate : _dfsList) {
-            if (gate->_TYPE == 'A')  fecGroup.insert({gate->_ID, {gate,false}}); }
-        _fecList.push_front(make_pair(0,fecGroup)); }
+    if (numFEC() == 0 && !fraiged) { // Put CONST and all aig gates in one FEC class (if fraiged, don't put again)
+        _fecMember.clear();
+        _fecMember.push_back(0);
+        for (auto id : _dfsList) {
+            if (_gateType[id] == 'A') { _fecMember.push_back(id); } }
+        sort(_fecMember.begin(), _fecMember.end());
+        _fecStart.assign(1, 0);
+        _fecStart.push_back(_fecMember.size()); }
 }
 
+// Drop gates merged by fraig, then map every member to its class
 void
 CirMgr::store_FEC()
 {
-    sort(_fecList.begin(), _fecList.end(),
-    [](pair<int, map<int, pair<CirGate*, bool>>>& lhs, pair<int, map<int, pair<CirGate*, bool>>>& rhs)
-    { return lhs.first < rhs.first; });
+    int k = 0, w = 0, b = 0;
+    for (int c = 0, n = numFEC(); c < n; c++) {
+        int e = _fecStart[c+1], start = w;
+        for (int i = b; i < e; i++)
+            if (!_gateArena[_fecMember[i]]._removed) { _fecMember[w++] = _fecMember[i]; }
+        if (w - start > 1) { _fecStart[++k] = w; }
+        else { w = start; }
+        b = e;
+    }
+    _fecStart.resize(k + 1);
+    _fecMember.resize(w);
+
+    for (auto id : _dfsList) { _fecClass[id] = -1; } // for safety purpose
+    _fecClass[0] = -1;
+    for (int c = 0; c < numFEC(); c++)
+        for (int i = _fecStart[c]; i < _fecStart[c+1]; i++) { _fecClass[_fecMember[i]] = c; }
+}
+
+// Split every FEC class by the first "words" simulation words. Signatures are
+// normalized to bit 0 of word 0 being 0, so a gate and its complement hash to
+// the same slot of one reusable table. Gates merged by fraig and singleton
+// classes are dropped. Returns the number of classes.
+int
+CirMgr::refineFEC(int words)
+{
+    const size_t stride = _simWords;
+    const size_t* value = _simValue.data();
+    _fecNewMember.clear();
+    _fecNewStart.assign(1, 0);
+
+    for (int c = 0, n = numFEC(); c < n; c++) {
+        const int b = _fecStart[c], e = _fecStart[c+1];
+        if ((int)_fecSub.size() < e - b) {
+            _fecSub.resize(e - b);
+            _fecSubRep.resize(e - b);
+            _fecSubPos.resize(e - b); }
+        if (_fecTableStamp.size() < 2 * size_t(e - b)) {
+            size_t size = 64;
+            while (size < 2 * size_t(e - b)) { size <<= 1; }
+            _fecTableStamp.assign(size, 0);
+            _fecTableSub.resize(size);
+            _fecStamp = 0; }
+        if (++_fecStamp == 0) { // wrapped, forget every slot
+            _fecTableStamp.assign(_fecTableStamp.size(), 0);
+            _fecStamp = 1; }
+        const size_t slotMask = _fecTableStamp.size() - 1;
+
+        // Members are visited in ID order, so sub-classes are numbered by
+        // their smallest member
+        int nSub = 0;
+        for (int i = b; i < e; i++) {
+            const int id = _fecMember[i];
+            if (_gateArena[id]._removed) { _fecSub[i-b] = -1; continue; }
+            const size_t* v = value + id * stride;
+            const size_t mask = -(v[0] & 1);
+            size_t slot = simHash(v, mask, words) & slotMask;
+            int sub;
+            while (true) {
+                if (_fecTableStamp[slot] != _fecStamp) {
+                    _fecTableStamp[slot] = _fecStamp;
+                    _fecTableSub[slot] = sub = nSub++;
+                    _fecSubRep[sub] = id;
+                    _fecSubPos[sub] = 0;
+                    break; }
+                const size_t* r = value + _fecSubRep[_fecTableSub[slot]] * stride;
+                const size_t rmask = -(r[0] & 1);
+                int w = 0;
+                while (w < words && (r[w] ^ rmask) == (v[w] ^ mask)) { w++; }
+                if (w == words) { sub = _fecTableSub[slot]; break; }
+                slot = (slot + 1) & slotMask;
+            }
+            _fecSub[i-b] = sub;
+            _fecSubPos[sub]++;
+        }
 
-    for (auto gate : _dfsList) { gate->_gatefecList = 0; } // for safety purpose
-    for (auto iter = _fecList.begin(); iter != _fecList.end(); iter++) { // store pointer of map to gate
-        for (auto it : iter->second)
-            it.second.first->_gatefecList = &(iter->second);
+        // Lay out sub-classes with more than one member, keeping ID order
+        int pos = _fecNewMember.size();
+        for (int s = 0; s < nSub; s++) {
+            int size = _fecSubPos[s];
+            if (size > 1) {
+                _fecSubPos[s] = pos;
+                pos += size;
+                _fecNewStart.push_back(pos); }
+            else { _fecSubPos[s] = -1; }
+        }
+        _fecNewMember.resize(pos);
+        for (int i = b; i < e; i++) {
+            const int s = _fecSub[i-b];
+            if (s >= 0 && _fecSubPos[s] >= 0) { _fecNewMember[_fecSubPos[s]++] = _fecMember[i]; }
+        }
     }
+
+    // Sort classes by their smallest member
+    const int nClass = _fecNewStart.size() - 1;
+    _fecOrder.clear();
+    for (int c = 0; c < nClass; c++) { _fecOrder.push_back({_fecNewMember[_fecNewStart[c]], c}); }
+    sort(_fecOrder.begin(), _fecOrder.end());
+    _fecMember.clear();
+    _fecStart.assign(1, 0);
+    for (auto& o : _fecOrder) {
+        _fecMember.insert(_fecMember.end(), _fecNewMember.begin() + _fecNewStart[o.second],
+                          _fecNewMember.begin() + _fecNewStart[o.second+1]);
+        _fecStart.push_back(_fecMember.size()); }
+    return nClass;
 }
 
 /************************************************/
 /*   Public member functions about Simulation   */
 /************************************************/
 
+// Progress is measured in candidate pairs, FEC members minus classes (the
+// SAT calls fraig() would make at most); it drops with every split, also
+// those that leave the number of classes unchanged. Simulation stops once
+// the last 64 words (4096 patterns) removed no pair, once no pair is left,
+// or when "maxPatterns" / "maxSeconds" (0: 2<<12 rounds / no limit) is spent.
+// With "guided", the first stop switches to guided rounds aimed at the
+// largest class, which stop by the same rules: PIs in its fanin cone flip
+// about 1/8 of the bits of the last round that removed pairs or, every
+// other round, lean 3:1 to the value each took most often in that round;
+// the other PIs stay uniform.
 void
-CirMgr::randomSim()
+CirMgr::randomSim(size_t maxPatterns, int maxSeconds, bool guided)
 {
     if (fraiged) { return; }// no need to repeat
-    int _size    = 0;       // number of FEC groups
-    int prevsize = 0;       // previous number of FEC groups
     int time     = 0;       // number of simulations
-    int max_time = 2<<12;   // max number of simulations
     int min_time = 4;       // min number of simulations
-    int same     = 0;       // number of simulations with same number of FEC groups
-    int max_same;
-    if (I < 20)        { max_same = 3;   }
-    else if (I < 100)  { max_same = 10;  }
-    else if (I < 1000) { max_same = 50;  }
-    else {               max_same = 100; }
-
-    vector<string> input;
+    int phase    = 0;       // round the guided rounds started after
+    bool guiding = false;
+    const size_t block = 64 * _simWords;
+    const int window = std::max(1, 64 / _simWords); // rounds in 64 words
+    if (!maxPatterns) { maxPatterns = (2<<12) * block; }
+    if (_simThreads > 1) { buildLevels(); }
+    resetSimCone();
+
     #ifndef noprint
     cout<<endl<<"Total #FEC Group = 0"<<flush;
     #endif
     if (!simed) { add_first_FEC(); }
 
-    while (time < min_time || (time < max_time && same < max_same)) {
+    vector<size_t> pairs(1, _fecMember.size() - numFEC()); // after each round
+    vector<size_t> base(I * _simWords, 0); // PI words of the last round with progress
+    vector<char> support;                  // PIs in the cone of the largest class
+    const auto start = chrono::steady_clock::now();
+    while (true) {
         time++;
-        prevsize = _size;
-        input.clear();
         // Generate Random patterns
-        for (auto iter = _piList.begin(); iter != _piList.end(); iter++)
-            (*iter)->_value = (size_t)rnGen(1<<16)<<48 | (size_t)rnGen(1<<16)<<32 |
-                          (size_t)rnGen(1<<16)<<16 | rnGen(1<<16);
-        _size = Simulate(true, input);
-        if (_size == prevsize) { same++; }
-        else { same = 0; }
+        if (!guiding) {
+            for (auto iter = _piList.begin(); iter != _piList.end(); iter++)
+                rnGen.fill(&_simValue[(*iter)->_ID * _simWords], _simWords); }
+        else {
+            for (int j = 0; j < I; j++) {
+                size_t* v = &_simValue[_piList[j]->_ID * _simWords];
+                const size_t* b = &base[j * _simWords];
+                int ones = 0;
+                for (int w = 0; w < _simWords; w++) { ones += __builtin_popcountll(b[w]); }
+                const bool high = ones * 2 > 64 * _simWords;
+                for (int w = 0; w < _simWords; w++) {
+                    const size_t r = rnGen.next();
+                    if (!support[j]) { v[w] = r; }
+                    else if (time % 2) { v[w] = b[w] ^ (r & rnGen.next() & rnGen.next()); }
+                    else { v[w] = high ? (r | rnGen.next()) : (r & rnGen.next()); } } } }
+        Simulate(block);
+        pairs.push_back(_fecMember.size() - numFEC());
+
+        if (pairs[time] == 0 || time * block >= maxPatterns) { break; }
+        if (maxSeconds && chrono::duration<double>(chrono::steady_clock::now() - start).count() >= maxSeconds)
+            break;
+        if (pairs[time] < pairs[time-1]) {
+            for (int j = 0; j < I; j++)
+                copy_n(&_simValue[_piList[j]->_ID * _simWords], _simWords, &base[j * _simWords]);
+            if (guiding) { largestClassSupport(support); } }
+        if (time - phase >= min_time && time - phase >= window && pairs[time - window] == pairs[time]) {
+            if (!guided || guiding) { break; }
+            guiding = true;
+            phase = time;
+            largestClassSupport(support); }
     }
 
     #ifndef noprint
-    cout<<"\r"<<time*64<<" patterns simulated."<<endl;
+    cout<<"\r"<<time*block<<" patterns simulated."<<endl;
     #endif
+    if (_simThreads > 1) { printLevelTime(); }
+    syncSimValues();
     store_FEC();
     simed = true;
 }
 
+// PIs (by index in _piList) in the fanin cone of the largest FEC class
+void
+CirMgr::largestClassSupport(vector<char>& support) const
+{
+    int big = 0;
+    for (int c = 1; c < numFEC(); c++)
+        if (_fecStart[c+1] - _fecStart[c] > _fecStart[big+1] - _fecStart[big]) { big = c; }
+    vector<char> mark(_gateList.size(), false);
+    vector<int> stack(_fecMember.begin() + _fecStart[big], _fecMember.begin() + _fecStart[big+1]);
+    for (auto id : stack) { mark[id] = true; }
+    while (!stack.empty()) {
+        int id = stack.back();
+        stack.pop_back();
+        for (int i = 0; i < 2; i++) {
+            CirLit lit = _faninLit[2*id+i];
+            if (lit == CIR_NO_LIT || mark[lit/2]) { continue; }
+            mark[lit/2] = true;
+            stack.push_back(lit/2); }
+    }
+    support.resize(I);
+    for (int j = 0; j < I; j++) { support[j] = mark[_piList[j]->_ID]; }
+}
+
 void
 CirMgr::fileSim(ifstream& patternFile)
 {
     bool wrong_input = false;
     int pattern = 0;
-    string str;
-    vector<string> input;
+    int block = 64 * _simWords; // patterns per simulation
+    if (_simThreads > 1) { buildLevels(); }
+    resetSimCone();
+    // Patterns are packed as rows of PI bits, 64 rows at a time, and the
+    // 64-row tile is transposed into one simulation word of every PI
+    const int rowWords = (I + 63) / 64;
+    vector<size_t> tile(64 * rowWords, 0);
+    CirPatternReader reader(patternFile);
+    const char* str;
+    size_t len;
     if (!simed) { add_first_FEC(); }
-    while (patternFile >> str) {
-        if ((int)str.size() != I) {
-            cerr<<endl<<"Error: Pattern("<<str<<") length("<<str.size()
+    while (reader.next(str, len)) {
+        if ((int)len != I) {
+            cerr<<endl<<"Error: Pattern("<<string(str, len)<<") length("<<len
                 <<") does not match the number of inputs("<<I<<") in a circuit!!"<<endl;
-            pattern -= pattern % 64;
+            pattern -= pattern % block;
             wrong_input = true;
             break; }
-        if (str.find_first_not_of("01") != string::npos) {
-            cerr<<endl<<"Error: Pattern("<<str<<") contains a non-0/1 character('"
-                <<str[str.find_first_not_of("01")]<<"')."<<endl;
-            pattern -= pattern % 64;
+        if (!packPatternRow(str, len, &tile[pattern % 64 * rowWords])) {
+            size_t bad = 0;
+            while (str[bad] == '0' || str[bad] == '1') { bad++; }
+            cerr<<endl<<"Error: Pattern("<<string(str, len)<<") contains a non-0/1 character('"
+                <<str[bad]<<"')."<<endl;
+            pattern -= pattern % block;
             wrong_input = true;
             break; }
 
-        input.push_back(str);
         pattern++;
-        if (pattern % 64 == 0) {
-            int j = 0;
-            for (auto iter = _piList.begin(); iter != _piList.end(); iter++) {
-                string value = "";
-                for (int i = 63; i >= 0; i--) { value += input[i][j]; }
-                (*iter)->_value = stoull(value, nullptr, 2);
-                j++; }
-            Simulate(false, input);
-            input.clear(); }
-    }
-
-    if (pattern % 64 != 0) {
-        int j = 0;
-        for (auto iter = _piList.begin(); iter != _piList.end(); iter++) {
-            string value = "";
-            for (int i = pattern % 64 -1; i >= 0; i--) { value += input[i][j];}
-            (*iter)->_value = stoull(value, nullptr, 2);
-            j++;
-        }
-        Simulate(false, input, pattern%64);
+        if (pattern % 64 == 0) { setPIWord(tile, (pattern - 1) % block / 64); }
+        if (pattern % block == 0) {
+            Simulate(block); }
+    }
+
+    if (pattern % block != 0) {
+        if (pattern % 64 != 0) { // rows past the last pattern read as 0
+            fill(tile.begin() + pattern % 64 * rowWords, tile.end(), 0);
+            setPIWord(tile, pattern % block / 64); }
+        Simulate(pattern % block);
     }
     cout<<"\r"<<pattern<<" patterns simulated."<<endl;
-    if (!wrong_input && !fraiged) { store_FEC(); }
+    if (_simThreads > 1) { printLevelTime(); }
+    syncSimValues();
+    // Blocks simulated before a bad pattern have refined the classes already
+    if (pattern > 0 || (!wrong_input && !fraiged)) { store_FEC(); }
     simed = true;
 }
 
+void
+CirMgr::setSimWords(int words)
+{
+    _simWords = words;
+    _simValue.assign(_gateList.size() * words, 0);
+}
+
+void
+CirMgr::setSimThreads(int threads)
+{
+    _levelStart.clear();
+    if (threads == _simThreads) { return; }
+    stopSimWorkers();
+    _simThreads = threads;
+    for (int t = 1; t < threads; t++) { _simWorkers.emplace_back(&CirMgr::simWorker, this, t, _simRound); }
+}
+
+void
+CirMgr::stopSimWorkers()
+{
+    {
+        lock_guard<mutex> lock(_simLock);
+        _simQuit = true;
+    }
+    _simWake.notify_all();
+    for (auto& th : _simWorkers) { th.join(); }
+    _simWorkers.clear();
+    _simQuit = false;
+}
+
+// Sort AIGs and POs by level (1 + max fanin level; PI/CONST/UNDEF are 0)
+// into _levelList, level L occupying [_levelStart[L-1], _levelStart[L])
+void
+CirMgr::buildLevels()
+{
+    vector<int> level(_gateList.size(), 0);
+    vector<int> count(1, 0);
+    for (auto id : _dfsList) {
+        if (_gateType[id] != 'A' && _gateType[id] != 'O') { continue; }
+        int l = level[_faninLit[2*id]/2];
+        if (_gateType[id] == 'A') { l = std::max(l, level[_faninLit[2*id+1]/2]); }
+        level[id] = ++l;
+        if ((int)count.size() <= l) { count.resize(l+1, 0); }
+        count[l]++;
+    }
+    _levelStart.assign(count.size(), 0);
+    for (size_t l = 1; l < count.size(); l++) { _levelStart[l] = _levelStart[l-1] + count[l]; }
+    _levelList.resize(_levelStart.back());
+    vector<int> pos(_levelStart.begin(), _levelStart.end()-1);
+    for (auto id : _dfsList)
+        if (level[id]) { _levelList[pos[level[id]-1]++] = id; }
+    _levelTime.assign(count.size()-1, 0);
+}
+
+void
+CirMgr::printLevelTime() const
+{
+    cout<<"Level   #Gates   Time(ms)   ("<<_simThreads<<" threads)"<<endl;
+    for (size_t l = 0; l < _levelTime.size(); l++)
+        cout<<setw(5)<<l+1<<setw(9)<<_levelStart[l+1]-_levelStart[l]
+            <<setw(11)<<fixed<<setprecision(3)<<_levelTime[l]*1000<<endl;
+    cout.unsetf(ios::floatfield);
+}
+
 /*************************************************/
 /*   Private member functions about Simulation   */
 /*************************************************/
-int
-CirMgr::Simulate(bool random, vector<string>& input, int num)
+// Gates of one level only depend on lower levels: split each level among
+// _simThreads threads and synchronize with a barrier between levels. The
+// workers stay alive between rounds, sleeping on _simWake.
+void
+CirMgr::simulateLevels(int words)
 {
-    for (auto gate : _dfsList) // Stimulate entire circuit
     {
-        if (gate->_TYPE == 'A') {
-            size_t in1 = gate->_fanin1.first->_value;
-            size_t in2 = gate->_fanin2.first->_value;
-            if (gate->_fanin1.second) { in1 = ~in1; }
-            if (gate->_fanin2.second) { in2 = ~in2; }
-            gate->_value = in1 & in2; }
-        else if (gate->_TYPE == 'O') {
-            size_t in1 = gate->_fanin1.first->_value;
-            if (gate->_fanin1.second) { in1 = ~in1; }
-            gate->_value = in1; }
-    }
-
-    int _size = _fecList.size();
-    for (int i = 0 ; i < _size; i++) {
-        unordered_map<SimKey, map<int, pair<CirGate*, bool>>> Hash;
-        for (auto in : _fecList.front().second) {
-            auto m = Hash.find(SimKey(in.second.first, false));
-            if (m != Hash.end()) { m->second.insert({in.second.first->_ID, {in.second.first, false}}); continue; }
-            auto n = Hash.find(SimKey(in.second.first, true));
-            if (n != Hash.end()) { n->second.insert({in.second.first->_ID, {in.second.first, true}}); continue; }
-            Hash.insert({SimKey(in.second.first,false),map<int, pair<CirGate*, bool>>{{in.second.first->_ID, {in.second.first,false}}}});
+        lock_guard<mutex> lock(_simLock);
+        _simRoundWords = words;
+        _simRound++;
+    }
+    _simWake.notify_all();
+    simulateLevelShare(0, words);
+}
+
+// Wait for each round after round "seen" and do share "t" of it
+void
+CirMgr::simWorker(int t, int seen)
+{
+    while (true) {
+        int words;
+        {
+            unique_lock<mutex> lock(_simLock);
+            _simWake.wait(lock, [&]() { return _simQuit || _simRound != seen; });
+            if (_simQuit) { return; }
+            seen = _simRound;
+            words = _simRoundWords;
         }
-        for (auto bucket : Hash) {
-            if (bucket.second.size() > 1) { _fecList.push_back(make_pair(bucket.second.begin()->first, bucket.second)); }
+        simulateLevelShare(t, words);
+    }
+}
+
+// Share "t" of every level; the last barrier is passed only once all
+// threads are done with the round
+void
+CirMgr::simulateLevelShare(int t, int words)
+{
+    const int nThread = _simThreads;
+    const int nLevel = _levelTime.size();
+    const size_t stride = _simWords;
+    const SimAndFunc kernel = words < 4 ? simAndScalar : simAnd;
+    const CirLit* lit = _faninLit.data();
+    const char* type = _gateType.data();
+    size_t* value = _simValue.data();
+
+    auto barrier = [&]() {
+        int p = _simPhase.load();
+        if (_simArrived.fetch_add(1) == nThread - 1) { _simArrived.store(0); _simPhase.fetch_add(1); }
+        else { while (_simPhase.load() == p) { this_thread::yield(); } }
+    };
+    auto last = chrono::steady_clock::now();
+    for (int l = 0; l < nLevel; l++) {
+        int b = _levelStart[l], e = _levelStart[l+1];
+        int chunk = (e - b + nThread - 1) / nThread;
+        for (int i = b + t * chunk, n = std::min(e, b + (t+1) * chunk); i < n; i++)
+            simGate(_levelList[i], type[_levelList[i]], lit, value, stride, words, kernel);
+        barrier();
+        if (t == 0) {
+            auto now = chrono::steady_clock::now();
+            _levelTime[l] += chrono::duration<double>(now - last).count();
+            last = now; }
+    }
+}
+
+// Word "w" of every PI from a tile of 64 pattern rows (PI j is bit j of a row)
+void
+CirMgr::setPIWord(const vector<size_t>& tile, int w)
+{
+    const int rowWords = (I + 63) / 64;
+    size_t a[64];
+    for (int t = 0; t < rowWords; t++) {
+        for (int k = 0; k < 64; k++) { a[k] = tile[k * rowWords + t]; }
+        transpose64(a);
+        for (int j = 0; j < 64 && 64*t + j < I; j++)
+            _simValue[_piList[64*t + j]->_ID * _simWords + w] = a[j]; }
+}
+
+// Gates to simulate: _dfsList, or the fanin cone of the FEC members once it
+// is below 3/4 of the circuit. The cone is rebuilt whenever the members have
+// shrunk to 3/4 since the last build, so late rounds cost about as much as
+// the surviving candidates. The sim log needs every PO, hence the full list.
+const vector<int>&
+CirMgr::simOrder()
+{
+    if (_simLog) { return _dfsList; }
+    const int members = _fecMember.size();
+    if (_coneMembers < 0 || members * 4 < _coneMembers * 3) {
+        vector<char> inCone(_gateList.size(), false);
+        for (auto id : _fecMember) { inCone[id] = true; }
+        for (auto it = _dfsList.rbegin(); it != _dfsList.rend(); it++) {
+            if (!inCone[*it] || _gateType[*it] != 'A') { continue; }
+            inCone[_faninLit[2 * *it] / 2]     = true;
+            inCone[_faninLit[2 * *it + 1] / 2] = true;
         }
-        _fecList.pop_front();
+        _simCone.clear();
+        for (auto id : _dfsList)
+            if (inCone[id] && _gateType[id] == 'A') { _simCone.push_back(id); }
+        _coneMembers = members;
+    }
+    if (_simCone.size() * 4 >= _dfsList.size() * 3) { return _dfsList; }
+    _coneStale = true;
+    return _simCone;
+}
+
+// Bring gates outside the cone up to date with the last patterns
+void
+CirMgr::syncSimValues()
+{
+    if (!_coneStale) { return; }
+    const size_t stride = _simWords;
+    const SimAndFunc kernel = _lastWords < 4 ? simAndScalar : simAnd;
+    for (auto id : _dfsList)
+        simGate(id, _gateType[id], _faninLit.data(), _simValue.data(), stride, _lastWords, kernel);
+    _coneStale = false;
+}
+
+// Simulate the first "num" patterns, i.e. (num+63)/64 words of each gate
+int
+CirMgr::Simulate(int num)
+{
+    const int words = (num + 63) / 64;
+    const size_t stride = _simWords;
+    const SimAndFunc kernel = words < 4 ? simAndScalar : simAnd;
+    const CirLit* lit = _faninLit.data();
+    size_t* value = _simValue.data();
+    _lastWords = words;
+    if (_simThreads > 1 && !_levelStart.empty()) { simulateLevels(words); }
+    else {
+        for (auto id : simOrder()) // Stimulate entire circuit, or the cone of the FEC members
+            simGate(id, _gateType[id], lit, value, stride, words, kernel);
     }
 
-    _size = _fecList.size();
+    int _size = refineFEC(words);
+
     #ifndef noprint
     cout<<"\33[2K\r"<<"Total #FEC Group = "<<_size<<flush;
     #endif
 
-    if (_simLog) {
-        if (random) {
-            vector<string> pi;
-            for (auto iter = _piList.begin(); iter != _piList.end(); iter++)
-            pi.push_back(bitset<64>((*iter)->_value).to_string());
-            for (int i = 63; i >= 0; i--) {
-                string input_string = "";
-                for (int j = 0; j < I; j++) { input_string += pi[j][i]; }
-                    input.push_back(input_string); }
-        }
-        vector<string> po;
-        vector<string> output;
-        for (auto iter = _poList.begin(); iter != _poList.end(); iter++)
-            po.push_back(bitset<64>((*iter)->_value).to_string());
-        for (int i = 63; i >= 0; i--) {
-            string output_string = "";
-            for (int j = 0; j < O; j++) { output_string += po[j][i]; }
-                output.push_back(output_string); }
-        for (int i = 0; i < num; i++) { (*_simLog)<<input[i]<<" "<<output[i]<<endl; }
-    }
+    if (_simLog) { writeSimLog(num); }
     return _size;
 }
+
+// Log the first "num" patterns of the PIs and POs. The text log has one
+// line "<PI bits> <PO bits>" per pattern, built for the whole block in
+// _simLogBuf and written at once. The binary log (see setSimLog()) has
+// per block the pattern count as a 32-bit integer, then the (num+63)/64
+// words of each PI and of each PO.
+void
+CirMgr::writeSimLog(int num)
+{
+    const int words = (num + 63) / 64;
+    const size_t stride = _simWords;
+    if (_simLogBinary) {
+        const uint32_t n = num;
+        _simLog->write((const char*)&n, sizeof(n));
+        for (auto gate : _piList)
+            _simLog->write((const char*)&_simValue[gate->_ID * stride], words * sizeof(size_t));
+        for (auto gate : _poList)
+            _simLog->write((const char*)&_simValue[gate->_ID * stride], words * sizeof(size_t));
+        return; }
+
+    const size_t lineLen = I + O + 2;
+    _simLogBuf.resize(num * lineLen);
+    char* buf = _simLogBuf.data();
+    for (int k = 0; k < num; k++) {
+        buf[k * lineLen + I] = ' ';
+        buf[k * lineLen + lineLen - 1] = '\n'; }
+    writeBitColumns(_piList, _simValue.data(), stride, num, buf, lineLen);
+    writeBitColumns(_poList, _simValue.data(), stride, num, buf + I + 1, lineLen);
+    _simLog->write(buf, _simLogBuf.size());
+}
+
+void
+CirMgr::setSimLog(ofstream* logFile, bool binary)
+{
+    _simLog = logFile;
+    _simLogBinary = binary;
+    if (_simLog && binary) { // header: magic, then #PI and #PO as 32-bit integers
+        const uint32_t io[2] = { (uint32_t)I, (uint32_t)O };
+        _simLog->write("FRAIGSIM", 8);
+        _simLog->write((const char*)io, sizeof(io)); }
+}
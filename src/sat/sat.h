@@ -65,6 +65,30 @@ class SatSolver
          _solver->addClause(lits); lits.clear();
       }
 
+      // One-sided miter vf -> (a xor b); fa/fb = true if it is inverted.
+      // Retire it with assertProperty(vf, false) once the proof is done.
+      void addMiterCNF(Var vf, Var va, bool fa, Var vb, bool fb) {
+         vec<Lit> lits;
+         Lit lf = Lit(vf);
+         Lit la = fa? ~Lit(va): Lit(va);
+         Lit lb = fb? ~Lit(vb): Lit(vb);
+         lits.push( la); lits.push( lb); lits.push(~lf);
+         _solver->addClause(lits); lits.clear();
+         lits.push(~la); lits.push(~lb); lits.push(~lf);
+         _solver->addClause(lits); lits.clear();
+      }
+
+      // Assert a == b; fa/fb = true if it is inverted
+      void assertEquivalence(Var va, bool fa, Var vb, bool fb) {
+         vec<Lit> lits;
+         Lit la = fa? ~Lit(va): Lit(va);
+         Lit lb = fb? ~Lit(vb): Lit(vb);
+         lits.push( la); lits.push(~lb);
+         _solver->addClause(lits); lits.clear();
+         lits.push(~la); lits.push( lb);
+         _solver->addClause(lits); lits.clear();
+      }
+
       // For incremental proof, use "assumeSolve()"
       void assumeRelease() { _assump.clear(); }
       void assumeProperty(Var prop, bool val) {
@@ -13,17 +13,46 @@
 #include <stdlib.h>  
 #include <limits.h>
 
-#define my_srandom  srandom
-#define my_random   random
+#include <stddef.h>
 
+// xoshiro256** generator: 64 random bits per call, state seeded through
+// splitmix64 so that any seed (0 included) gives a good start
 class RandomNumGen
 {
    public:
-      RandomNumGen() { my_srandom(getpid()); }
-      RandomNumGen(unsigned seed) { my_srandom(seed); }
-      const int operator() (const int range) const {
-         return int(range * (double(my_random()) / INT_MAX));
+      RandomNumGen() { reset(getpid()); }
+      RandomNumGen(unsigned seed) { reset(seed); }
+      void reset(unsigned long long seed) {
+         for (int i = 0; i < 4; ++i) {
+            seed += 0x9e3779b97f4a7c15ULL;
+            unsigned long long z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            _s[i] = z ^ (z >> 31);
+         }
       }
+      // uniform in [0, range)
+      int operator() (const int range) {
+         return int(((next() >> 32) * (unsigned long long)range) >> 32);
+      }
+      unsigned long long next() {
+         const unsigned long long r = rotl(_s[1] * 5, 7) * 9;
+         const unsigned long long t = _s[1] << 17;
+         _s[2] ^= _s[0]; _s[3] ^= _s[1]; _s[1] ^= _s[2]; _s[0] ^= _s[3];
+         _s[2] ^= t;
+         _s[3] = rotl(_s[3], 45);
+         return r;
+      }
+      // "n" words of random bits, e.g. a block of simulation patterns
+      void fill(size_t* words, size_t n) {
+         for (size_t i = 0; i < n; ++i) words[i] = next();
+      }
+
+   private:
+      static unsigned long long rotl(unsigned long long x, int k) {
+         return (x << k) | (x >> (64 - k));
+      }
+      unsigned long long _s[4];
 };
 
 #endif // RN_GEN_H